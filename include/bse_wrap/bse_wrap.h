@@ -125,6 +125,106 @@ typedef struct{
     int bse_bcm_formation[2];
 } bse_binary;
 
+/**
+* @brief Per-call BSE state. Holds everything CMC changes between calls to BSE (MS timestep fraction, merger flag, pass-through ids and the rng state) so that a star can be evolved without going through the COMMON-block setters. Outputs from the bcm array that CMC needs are copied back into the context.
+*/
+typedef struct{
+/**
+* @brief timestep taken in MS phase
+*/
+	double pts1;
+/**
+* @brief timestep taken in GB, CHeB, AGB, HeGB phases
+*/
+	double pts2;
+/**
+* @brief timestep taken in HG, HeMS phases
+*/
+	double pts3;
+/**
+* @brief merger flag passed through to evolv2.f
+*/
+	double merger;
+/**
+* @brief cmc id of the single star or star 1 in the binary
+*/
+	long int id1_pass;
+/**
+* @brief cmc id of star 2 in the binary
+*/
+	long int id2_pass;
+/**
+* @brief tausworthe rng state, read before and written back after every call
+*/
+	struct rng_t113_state rng;
+/**
+* @brief last filled row of the bcm array after the call (0 if none)
+*/
+	int nbcm;
+/**
+* @brief pulsar magnetic field from the last bcm row
+*/
+	double bcm_B;
+/**
+* @brief 1 if a NS formed during the call, in which case bcm_formation is set
+*/
+	int bcm_formation_found;
+/**
+* @brief formation pathway of the NS formed during the call
+*/
+	double bcm_formation;
+} bse_context;
+
+/**
+* @brief A block of single stars stored as arrays (one entry per star), used to evolve many stars with one call to bse_evolv1_batch
+*/
+typedef struct{
+/**
+* @brief number of stars in the batch
+*/
+	long n;
+/**
+* @brief number of stars the arrays are allocated for
+*/
+	long nmax;
+/**
+* @brief caller's index of each star (not used by BSE)
+*/
+	long *idx;
+/**
+* @brief cmc star id passed through to BSE
+*/
+	long *id;
+/**
+* @brief stellar types
+*/
+	int *kw;
+/**
+* @brief initial masses, masses, radii, luminosities, core and envelope quantities, spins and pulsar quantities, as in bse_binary
+*/
+	double *mass0, *mass, *rad, *lum, *massc, *radc, *menv, *renv, *ospin, *B_0, *bacc, *tacc, *epoch, *tms, *bhspin;
+/**
+* @brief physical time of each star
+*/
+	double *tphys;
+/**
+* @brief MS timestep fraction to use for each star
+*/
+	double *pts1;
+/**
+* @brief birth kicks, 20 per star
+*/
+	double *vs;
+/**
+* @brief bcm outputs per star, see bse_context
+*/
+	int *nbcm, *bcm_formation_found;
+/**
+* @brief bcm outputs per star, see bse_context
+*/
+	double *bcm_B, *bcm_formation;
+} bse_batch;
+
 /* prototypes for fortran BSE functions */
 void zcnsts_(double *z, double *zpars);
 void evolv2_(int *kstar, double *mass, double *tb, double *ecc, double *z, 
@@ -132,6 +232,11 @@ void evolv2_(int *kstar, double *mass, double *tb, double *ecc, double *z,
              double *massc, double *radc, double *menv, double *renv,
 	     double *ospin, double *B_0, double *bacc, double *tacc, double *epoch,
 	     double *tms, double *bhspin, double *tphys, double *zpars, double *vs, double *kick_info);
+void evolv1_batch_(int *n, long *id, double *pts1, int *kw, double *mass0, double *mass, double *rad,
+		   double *lum, double *massc, double *radc, double *menv, double *renv, double *ospin,
+		   double *B_0, double *bacc, double *tacc, double *epoch, double *tms, double *bhspin,
+		   double *tphys, double *tphysf, double *dtp, double *z, double *zpars, double *vs,
+		   int *nbcm, double *bcm_B, int *bcm_formation_found, double *bcm_formation);
 void instar_(void);
 float ran3_(int *idum);
 void star_(int *kw, double *mass, double *mt, double *tm, double *tn, double *tscls, 
@@ -162,6 +267,15 @@ void bse_evolv2_safely(int *kstar, double *mass0, double *mass, double *rad, dou
                        double *B_0, double *bacc, double *tacc,
 		       double *epoch, double *tms, double *tphys, double *tphysf, double *dtp,
 		       double *z, double *zpars, double *tb, double *ecc, double *vs, double *bhspin);
+void bse_context_init(bse_context *ctx, struct rng_t113_state state);
+void bse_evolv2_ctx(bse_context *ctx, int *kstar, double *mass0, double *mass, double *rad, double *lum,
+		    double *massc, double *radc, double *menv, double *renv, double *ospin,
+                    double *B_0, double *bacc, double *tacc,
+		    double *epoch, double *tms, double *tphys, double *tphysf, double *dtp,
+		    double *z, double *zpars, double *tb, double *ecc, double *vs, double *bhspin);
+void bse_batch_alloc(bse_batch *batch, long nmax);
+void bse_batch_free(bse_batch *batch);
+void bse_evolv1_batch(bse_context *ctx, bse_batch *batch, double tphysf, double dtp, double *z, double *zpars);
 void bse_instar(void);
 void bse_star(int *kw, double *mass, double *mt, double *tm, double *tn, double *tscls, 
 	      double *lums, double *GB, double *zpars);
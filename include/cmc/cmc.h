@@ -21,6 +21,7 @@
 #include "CMCConfig.h"
 #include "stdarg.h"
 #include "cmc_mpi.h"
+#include "cmc_node_comm.h"
 
 
 #ifdef USE_FITS
@@ -465,6 +466,10 @@ typedef struct{
 */
 	double Y;
 /**
+* @brief  time up to which the star has been relaxed (BLOCK_TIMESTEP_LEVELS)
+*/
+	double t_relax;
+/**
 * @brief  pericenter distance
 */
 	double r_peri;
@@ -479,11 +484,11 @@ typedef struct{
 /**
 * @brief  whether or not the star has undergone a strong interaction (i.e., not relaxation)
 */
-	long   interacted;
+	int    interacted;
 /**
 * @brief whether or not object was involved in three-body binary formation
 */
-	long   threebb_interacted;
+	int    threebb_interacted;
 /**
 * @brief  index to the binary
 * @details If the star is a binary, this variable has a non-zero value. Moreover, the value of this variable indicates the index of the binary array which holds the properties of this binary. For example, if star[213].binind has the value 56, binary[56] contains the properties of that binary.
@@ -494,6 +499,10 @@ typedef struct{
 */
 	long   id;
 /**
+* @brief stellar types (see bse_wrap/bse/bse.f for the list)
+*/
+	int se_k;
+/**
 * @brief  radius
 */
 	double rad;
@@ -515,10 +524,6 @@ typedef struct{
 */
 	double se_zams_mass;
 /**
-* @brief stellar types (see bse_wrap/bse/bse.f for the list)
-*/
-	int se_k;
-/**
 * @brief ?
 */
 	double se_mt;
@@ -587,13 +592,17 @@ typedef struct{
 */
 	double se_scm_formation;
 /**
+* @brief time (in Myr) of the next full BSE call for a remnant skipped under SE_SKIP_REMNANTS
+*/
+	double se_tnext;
+/**
 * @brief Sourav: toy rejuvenation variables
 */
-	double createtime, createtimenew, createtimeold;
+	double createtime;
 /**
 * @brief ?
 */
-	double lifetime, lifetimeold, lifetimenew;
+	double lifetime;
 /**
 * @brief variable to keep track of excess energy (to be added back to cluster) 
 */
@@ -1431,6 +1440,96 @@ typedef struct{
 * @brief enable or disable timers. This would return a detailed profiling of the code, but uses barriers, so might slow down the code a bit.
 */
 	int TIMER;
+#define PARAMDOC_SE_SKIP_REMNANTS "skip full BSE calls for isolated white dwarfs and black holes between resyncs, updating them analytically with hrdiag instead (0=off, 1=on)"
+/**
+* @brief skip full BSE calls for isolated white dwarfs and black holes between resyncs, updating them analytically with hrdiag instead (0=off, 1=on)
+*/
+	int SE_SKIP_REMNANTS;
+#define PARAMDOC_SE_SKIP_INTERVAL "interval (in Myr) after which a remnant skipped by SE_SKIP_REMNANTS is passed through the full BSE again"
+/**
+* @brief interval (in Myr) after which a remnant skipped by SE_SKIP_REMNANTS is passed through the full BSE again
+*/
+	int SE_SKIP_INTERVAL;
+#define PARAMDOC_SE_BATCH_SIZE "number of single stars evolved per call to the batched BSE interface (0 evolves them one at a time)"
+/**
+* @brief number of single stars evolved per call to the batched BSE interface (0 evolves them one at a time)
+*/
+	int SE_BATCH_SIZE;
+#define PARAMDOC_SE_TABLE "interpolate unperturbed single stars from a precomputed SSE track table instead of calling BSE (0=off, 1=on)"
+/**
+* @brief interpolate unperturbed single stars from a precomputed SSE track table instead of calling BSE (0=off, 1=on)
+*/
+	int SE_TABLE;
+#define PARAMDOC_SE_TABLE_FILE "file used to cache the SSE track table of SE_TABLE; it is read if it matches the metallicity and BSE flags of the run, and written otherwise (NULL for no cache)"
+/**
+* @brief file used to cache the SSE track table of SE_TABLE; it is read if it matches the metallicity and BSE flags of the run, and written otherwise (NULL for no cache)
+*/
+	int SE_TABLE_FILE;
+#define PARAMDOC_SE_PTS1_WINDOW "half-width of the window around the predicted MS turnoff, in units of the MS lifetime, inside which massive MS stars use the reduced BSE timestep (0 reduces it for the whole MS)"
+/**
+* @brief half-width of the window around the predicted MS turnoff, in units of the MS lifetime, inside which massive MS stars use the reduced BSE timestep (0 reduces it for the whole MS)
+*/
+	int SE_PTS1_WINDOW;
+#define PARAMDOC_FUSED_DIAGNOSTICS "compute the per-step Lagrange radii, energies and binary totals in a single fused pass with one reduction"
+/**
+* @brief compute the per-step Lagrange radii, energies and binary totals in a single fused pass with one reduction
+*/
+	int FUSED_DIAGNOSTICS;
+#define PARAMDOC_CENTRAL_DISTRIBUTED "compute the central density estimators over each node's own stars and combine them with a reproducible sum"
+/**
+* @brief compute the central density estimators over each node's own stars and combine them with a reproducible sum
+*/
+	int CENTRAL_DISTRIBUTED;
+#define PARAMDOC_REPRODUCIBLE_SUMS "use reduction schemes for the energies, binary totals, central velocity dispersion and Lagrange-radius sums that give bitwise identical results for any number of processors"
+/**
+* @brief use reduction schemes for the energies, binary totals, central velocity dispersion and Lagrange-radius sums that give bitwise identical results for any number of processors
+*/
+	int REPRODUCIBLE_SUMS;
+#define PARAMDOC_TIDAL_STRIP_BUCKETS "Number of bins for the single-pass tidal stripping solver; 0 iterates the stripping until no more stars are removed"
+/**
+* @brief Number of bins for the single-pass tidal stripping solver; 0 iterates the stripping until no more stars are removed
+*/
+	int TIDAL_STRIP_BUCKETS;
+#define PARAMDOC_LOCAL_ENV_CACHE "Compute the sliding-window mass, velocity dispersion and density around each star once per timestep and share them between the timestep estimate and the dynamics"
+/**
+* @brief Compute the sliding-window mass, velocity dispersion and density around each star once per timestep and share them between the timestep estimate and the dynamics
+*/
+	int LOCAL_ENV_CACHE;
+#define PARAMDOC_BLOCK_TIMESTEP_LEVELS "Number of radial block-timestep levels; stars whose local relaxation timestep exceeds 2^L times the global one are relaxed and evolved only every 2^L steps (<=1 turns this off)"
+/**
+* @brief Number of radial block-timestep levels; stars whose local relaxation timestep exceeds 2^L times the global one are relaxed and evolved only every 2^L steps (<=1 turns this off)
+*/
+	int BLOCK_TIMESTEP_LEVELS;
+#define PARAMDOC_RELAX_BATCH "Number of single-single pairs whose two-body relaxation is queued and applied together in a vectorizable pass (0 relaxes each pair immediately)"
+/**
+* @brief Number of single-single pairs whose two-body relaxation is queued and applied together in a vectorizable pass (0 relaxes each pair immediately)
+*/
+	int RELAX_BATCH;
+#define PARAMDOC_COMPACT_CHECKPOINT "if set to 1, checkpoints store only the live part of the star and binary arrays instead of the full N_STAR_DIM_OPT and N_BIN_DIM_OPT records"
+/**
+* @brief if set to 1, checkpoints store only the live part of the star and binary arrays instead of the full N_STAR_DIM_OPT and N_BIN_DIM_OPT records
+*/
+	int COMPACT_CHECKPOINT;
+#define PARAMDOC_GLOBAL_ARRAYS_HUGEPAGES "if set to 1, the duplicated arrays star_r, star_m and star_phi are aligned to huge pages and advised to be backed by them"
+/**
+* @brief if set to 1, the duplicated arrays star_r, star_m and star_phi are aligned to huge pages and advised to be backed by them
+*/
+	int GLOBAL_ARRAYS_HUGEPAGES;
+#define PARAMDOC_HIER_COLLECTIVES "if set to 1, the collectives on the duplicated arrays are done in two levels, within each node and between one leader per node"
+/**
+* @brief if set to 1, the collectives on the duplicated arrays are done in two levels, within each node and between one leader per node
+*/
+	int HIER_COLLECTIVES;
+#define PARAMDOC_POTENTIAL_PIPELINE_SEGMENTS "if greater than 0, the gather of star_r and star_m after sorting is split into this many nonblocking segments, which the potential calculation consumes as they arrive"
+/**
+* @brief if greater than 0, the gather of star_r and star_m after sorting is split into this many nonblocking segments, which the potential calculation consumes as they arrive
+*/
+	int POTENTIAL_PIPELINE_SEGMENTS;
+#define PARAMDOC_SORT_SPLITTER_PREDICT "if set to 1, the splitters of the parallel sort are predicted from the partition of the previous sort, corrected with a globally summed histogram, instead of being sampled and gathered on the root"
+/**
+* @brief if set to 1, the splitters of the parallel sort are predicted from the partition of the previous sort, corrected with a globally summed histogram, instead of being sampled and gathered on the root
+*/
+	int SORT_SPLITTER_PREDICT;
 } parsed_t;
 
 
@@ -1614,6 +1713,68 @@ typedef struct{
 	double *sigma;
 } sigma_t;
 
+/* persistent exchange of a fixed number of doubles with the previous and next processors (no wrap-around) */
+typedef struct {
+	int count;           /* doubles sent to and received from each neighbour */
+	double *send_prev;   /* filled by the caller before mpiHaloStart() */
+	double *send_next;
+	double *recv_prev;   /* valid after mpiHaloWait(); untouched on the first/last processor */
+	double *recv_next;
+	MPI_Request req[4];
+} mpi_halo_t;
+void mpiHaloInit( mpi_halo_t *h, int count, MPI_Comm comm );
+void mpiHaloStart( mpi_halo_t *h );
+void mpiHaloWait( mpi_halo_t *h );
+void mpiHaloFree( mpi_halo_t *h );
+
+/* maximum value of BLOCK_TIMESTEP_LEVELS */
+#define BLOCK_TIMESTEP_MAX 16
+
+/* kernels held by the local environment cache */
+enum { LENV_AVE, LENV_BH, LENV_NKERNEL };
+
+/**
+* @brief per-timestep cache of the sliding-window averages around each local star (LOCAL_ENV_CACHE), shared by simul_relax_new() and dynamics_apply(). Entries are indexed by local star index, for the kernels AVEKERNEL (LENV_AVE) and BH_AVEKERNEL (LENV_BH).
+*/
+typedef struct{
+/**
+* @brief whether the cache matches the current positions and velocities
+*/
+	int valid;
+/**
+* @brief number of local stars covered
+*/
+	long n;
+/**
+* @brief allocated length of the arrays
+*/
+	long size;
+/**
+* @brief kernel half-widths
+*/
+	long p[LENV_NKERNEL];
+/**
+* @brief average of m (times madhoc) over the window
+*/
+	double *mave[LENV_NKERNEL];
+/**
+* @brief average of m^2 (times madhoc^2) over the window
+*/
+	double *m2ave[LENV_NKERNEL];
+/**
+* @brief average of m v^2 (times madhoc) over the window
+*/
+	double *mv2ave[LENV_NKERNEL];
+/**
+* @brief 3D velocity dispersion over the window
+*/
+	double *sigma[LENV_NKERNEL];
+/**
+* @brief local number density, as returned by calc_n_local()
+*/
+	double *n_local[LENV_NKERNEL];
+} local_env_t;
+
 
 /**
 * @brief parameters for orbit
@@ -1754,6 +1915,44 @@ typedef struct{
 	double rh;
 } clusdyn_struct_t;
 
+/**
+* @brief streaming weighted-quantile state, see wquantile_init()
+*/
+typedef struct{
+/**
+* @brief number of fractions
+*/
+	int nq;
+/**
+* @brief fractions of the total weight, in increasing order
+*/
+	double *q;
+/**
+* @brief quantiles, filled in as the fractions are crossed
+*/
+	double *out;
+/**
+* @brief total weight
+*/
+	double wtot;
+/**
+* @brief weight added so far
+*/
+	double wcum;
+/**
+* @brief cumulative fraction and position of the previous sample
+*/
+	double pprev, xprev;
+/**
+* @brief number of samples
+*/
+	long n;
+/**
+* @brief index of the next fraction to cross
+*/
+	int next;
+} wquantile_t;
+
 /********************** Function Declarations ************************/
 double sqr(double x);
 double cub(double x);
@@ -1782,6 +1981,10 @@ void create_timing_files();
 /* Bharath: Other refactored functions */
 void mpiBcastGlobArrays();
 void mpiInitGlobArrays();
+int star_array_reserve(long n);
+int binary_array_reserve(long n);
+void global_arrays_reserve(long n);
+void arrays_shrink_to_fit(void);
 void set_global_vars1();
 void set_global_vars2();
 void get_star_data(int argc, char *argv[], gsl_rng *rng);
@@ -1803,6 +2006,7 @@ void write_morecoll(long i);
 void toy_rejuvenation();
 void pre_sort_comm();
 void post_sort_comm();
+void post_sort_comm_start(void);
 void findIndices( long N, int blkSize, int i, int* begin, int* end );
 void pulsar_write(long k, double kick);
 void write_morepulsar(long i);
@@ -1832,6 +2036,14 @@ void print_denprof_snapshot(char* infile);
 
 void comp_mass_percent(void);
 void comp_multi_mass_percent(void);
+int find_stars_mass_bin(double smass);
+void wquantile_init(wquantile_t *wq, int nq, double *q, double *out, double wtot, long n);
+void wquantile_add(wquantile_t *wq, double x, double w);
+void wquantile_finish(wquantile_t *wq);
+void *scratch_alloc(size_t size);
+void *scratch_calloc(size_t n, size_t size);
+void scratch_reset(void);
+void diagnostics_calculate(void);
 orbit_rs_t calc_orbit_rs(long si, double E, double J);
 double get_positions(void);	/* get positions and velocities */
 void perturb_stars(double Dt);	/* take a time step (perturb E,J) */
@@ -1894,6 +2106,11 @@ void load_dynamical_friction_data(void);
 /* stellar evolution stuff */
 void stellar_evolution_init(void);
 void restart_stellar_evolution(void);
+double se_pts1(int kw, double zams_mass, double tphys, double epoch, double tms, double tphysf);
+void se_table_init(void);
+void se_table_free(void);
+int se_table_covers(long k, double tphysf);
+int se_table_evolve(long k, double tphysf);
 void do_stellar_evolution(gsl_rng *rng);
 void write_stellar_data(void);
 void handle_bse_outcome(long k, long kb, double *vs, double tphysf, int kprev0, int kprev1);
@@ -1915,6 +2132,9 @@ void destroy_obj_new(long i);
 void destroy_binary(long i);
 long create_star(int idx, int dyn_0_se_1);
 long create_binary(int idx, int dyn_0_se_1);
+void binary_slots_rebuild(void);
+void binary_slots_reset(long n);
+long binary_slots_live_end(void);
 void dynamics_apply(double dt, gsl_rng *rng);
 void perturb_stars_fewbody(double dt, gsl_rng *rng);
 void qsorts_new(void);
@@ -1989,6 +2209,11 @@ double simul_relax_new(void);
 int destroy_bbh(double m1, double m2,double a,double e,double nlocal,double sigma,struct rng_t113_state* rng_st);
 double simul_relax_new(void);
 void calc_sigma_r(long p, long N_LIMIT, double *sig_r, double *sig_sigma, long* sig_n, int r_0_mave_1);
+void local_env_calculate(void);
+void block_timestep_calculate(double Dt);
+int block_timestep_due(double r);
+void local_env_invalidate(void);
+void halos_free(void);
 void break_wide_binaries(struct rng_t113_state* rng_st);
 
 double sigma_r(double r);
@@ -5,15 +5,15 @@
  */
 struct densities {
 /**
-* @brief ?
+* @brief global indices of the local stars the density is estimated at
 */
   long *idx;
 /**
-* @brief ?
+* @brief estimated local densities
 */
   double *rho;
 /**
-* @brief ?
+* @brief number of local stars
 */
   long nave;
 };
@@ -59,6 +59,7 @@ struct core_t {
 void append_core_header(FILE *cfile, char *tag, int core_number);
 void write_core_data(FILE *cfile, struct core_t);
 struct core_t core_properties(struct densities rhoj);
+double *density_slice(long *idx, long nave, long nmem, int n_points);
 struct densities density_estimators(int n_point, int *startypes, int len);
 struct core_t no_remnants_core(int n_points);
 
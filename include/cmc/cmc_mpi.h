@@ -13,3 +13,10 @@ void mpiFindDispAndLen( long N, int* mpiDisp, int* mpiLen );
 void mpiFindDispAndLenCustom( long N, int blkSize, int* mpiDisp, int* mpiLen );
 void mpiFindIndicesCustom( long N, int blkSize, int i, int* mpiStart, int* mpiEnd );
 MPI_Comm inv_comm_create(int procs, MPI_Comm old_comm);
+
+/* number of pre-rounding levels of the reproducible sums */
+#define REPRO_LEVELS 3
+void mpiReproBounds( double *maxabs, int count, long ntot, double *M, double *step, MPI_Comm comm );
+void reproAdd( double x, double M, double step, double *part );
+void mpiReproFinish( double *part, int count, double *sums, MPI_Comm comm );
+void mpiReproSum( double *terms, long nloc, int count, long ntot, double *sums, MPI_Comm comm );
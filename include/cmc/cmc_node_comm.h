@@ -0,0 +1,20 @@
+/* vi: set filetype=c.doxygen: */
+#ifndef _CMC_NODE_COMM_H
+#define _CMC_NODE_COMM_H
+
+#include <mpi.h>
+
+/* Two-level (node-aware) versions of the collectives used on the duplicated arrays. With the layer
+ * active, data is first combined within each shared-memory node, then exchanged between one leader
+ * per node, and finally spread within the nodes again, so the inter-node traffic of the global arrays
+ * drops by the number of processes per node. Without it (or when the process layout does not allow
+ * it) they fall through to the flat MPI_COMM_WORLD collectives. The results are identical either way. */
+
+void node_comm_init(int enable);
+void node_comm_free(void);
+int node_comm_active(void);
+int node_allgatherv(const void *sendbuf, int sendcount, void *recvbuf, const int *recvcounts, const int *displs, MPI_Datatype type);
+int node_bcast(void *buf, int count, MPI_Datatype type, int root);
+int node_gather(const void *sendbuf, int count, MPI_Datatype type, void *recvbuf, int root);
+
+#endif
@@ -111,6 +111,78 @@ _EXTERN_ binary_t *binary;
 * @brief Variable to store the input parameter which triggers the functionality to profile/time in detal, individual parts of the code.
 */
 _EXTERN_ int TIMER;
+/**
+* @brief skip full BSE calls for isolated white dwarfs and black holes between resyncs, updating them analytically with hrdiag instead (0=off, 1=on)
+*/
+_EXTERN_ int SE_SKIP_REMNANTS;
+/**
+* @brief interval (in Myr) after which a remnant skipped by SE_SKIP_REMNANTS is passed through the full BSE again
+*/
+_EXTERN_ double SE_SKIP_INTERVAL;
+/**
+* @brief number of single stars evolved per call to the batched BSE interface (0 evolves them one at a time)
+*/
+_EXTERN_ int SE_BATCH_SIZE;
+/**
+* @brief interpolate unperturbed single stars from a precomputed SSE track table instead of calling BSE (0=off, 1=on)
+*/
+_EXTERN_ int SE_TABLE;
+/**
+* @brief file used to cache the SSE track table of SE_TABLE; it is read if it matches the metallicity and BSE flags of the run, and written otherwise (NULL for no cache)
+*/
+_EXTERN_ char *SE_TABLE_FILE;
+/**
+* @brief half-width of the window around the predicted MS turnoff, in units of the MS lifetime, inside which massive MS stars use the reduced BSE timestep (0 reduces it for the whole MS)
+*/
+_EXTERN_ double SE_PTS1_WINDOW;
+/**
+* @brief compute the per-step Lagrange radii, energies and binary totals in a single fused pass with one reduction
+*/
+_EXTERN_ int FUSED_DIAGNOSTICS;
+/**
+* @brief compute the central density estimators over each node's own stars and combine them with a reproducible sum
+*/
+_EXTERN_ int CENTRAL_DISTRIBUTED;
+/**
+* @brief use reduction schemes for the energies, binary totals, central velocity dispersion and Lagrange-radius sums that give bitwise identical results for any number of processors
+*/
+_EXTERN_ int REPRODUCIBLE_SUMS;
+/**
+* @brief Number of bins for the single-pass tidal stripping solver; 0 iterates the stripping until no more stars are removed
+*/
+_EXTERN_ int TIDAL_STRIP_BUCKETS;
+/**
+* @brief Compute the sliding-window mass, velocity dispersion and density around each star once per timestep and share them between the timestep estimate and the dynamics
+*/
+_EXTERN_ int LOCAL_ENV_CACHE;
+/**
+* @brief Number of radial block-timestep levels; stars whose local relaxation timestep exceeds 2^L times the global one are relaxed and evolved only every 2^L steps (<=1 turns this off)
+*/
+_EXTERN_ int BLOCK_TIMESTEP_LEVELS;
+/**
+* @brief Number of single-single pairs whose two-body relaxation is queued and applied together in a vectorizable pass (0 relaxes each pair immediately)
+*/
+_EXTERN_ int RELAX_BATCH;
+/**
+* @brief if set to 1, checkpoints store only the live part of the star and binary arrays instead of the full N_STAR_DIM_OPT and N_BIN_DIM_OPT records
+*/
+_EXTERN_ int COMPACT_CHECKPOINT;
+/**
+* @brief if set to 1, the duplicated arrays star_r, star_m and star_phi are aligned to huge pages and advised to be backed by them
+*/
+_EXTERN_ int GLOBAL_ARRAYS_HUGEPAGES;
+/**
+* @brief if set to 1, the collectives on the duplicated arrays are done in two levels, within each node and between one leader per node
+*/
+_EXTERN_ int HIER_COLLECTIVES;
+/**
+* @brief if greater than 0, the gather of star_r and star_m after sorting is split into this many nonblocking segments, which the potential calculation consumes as they arrive
+*/
+_EXTERN_ int POTENTIAL_PIPELINE_SEGMENTS;
+/**
+* @brief if set to 1, the splitters of the parallel sort are predicted from the partition of the previous sort, corrected with a globally summed histogram, instead of being sampled and gathered on the root
+*/
+_EXTERN_ int SORT_SPLITTER_PREDICT;
 
 /* file pointers */
 _EXTERN_ FILE *lagradfile, *dynfile, *lagrad10file, *logfile, *escfile, *snapfile, *ave_mass_file, *densities_file, *no_star_file, *centmass_file, **mlagradfile;
@@ -186,6 +258,8 @@ _EXTERN_ long snap_num, StepCount, bh_snap_num;
 _EXTERN_ long newstarid;
 _EXTERN_ double rho_core_single, rho_core_bin, rh_single, rh_binary;
 _EXTERN_ double TotalTime, Dt;
+/* smallest of the collision and binary encounter timestep limits of the current step */
+_EXTERN_ double DTenc;
 _EXTERN_ double Sin2Beta;
 /* arrays */
 /**
@@ -290,6 +364,11 @@ _EXTERN_ double madhoc;
 /* etc. */
 _EXTERN_ central_t central;
 _EXTERN_ sigma_t sigma_array;
+_EXTERN_ local_env_t local_env;
+/* block timesteps (BLOCK_TIMESTEP_LEVELS): inner radius of each level, and whether it is processed in the
+   current step */
+_EXTERN_ double block_r[BLOCK_TIMESTEP_MAX];
+_EXTERN_ int block_due[BLOCK_TIMESTEP_MAX];
 _EXTERN_ double Eoops; /* energy that has vanished from the system for various and sundry reasons */
 _EXTERN_ double E_bb, E_bs, DE_bb, DE_bs;
 /* FITS stuff */
@@ -22,6 +22,12 @@
 #include <stdlib.h>
 #include <math.h>
 #include "bse_wrap.h"
+#ifdef USE_THREADS
+#include <pthread.h>
+
+/* serializes access to the BSE COMMON blocks from bse_evolv2_ctx() */
+static pthread_mutex_t bse_common_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 /**
 * @brief calculate metallicity constants
@@ -311,6 +317,242 @@ void bse_evolv2_safely(int *kstar, double *mass0, double *mass, double *rad, dou
 }
 
 
+/**
+* @brief initialize a BSE context from the currently configured COMMON-block values
+*
+* @param ctx context to initialize
+* @param state C rng state the context starts from
+*/
+void bse_context_init(bse_context *ctx, struct rng_t113_state state)
+{
+  ctx->pts1 = points_.pts1;
+  ctx->pts2 = points_.pts2;
+  ctx->pts3 = points_.pts3;
+  ctx->merger = cmcpass_.merger;
+  ctx->id1_pass = 0;
+  ctx->id2_pass = 0;
+  ctx->rng = state;
+  ctx->nbcm = 0;
+  ctx->bcm_B = 0.0;
+  ctx->bcm_formation_found = 0;
+  ctx->bcm_formation = 0.0;
+}
+
+/**
+* @brief copies what CMC needs out of the bcm array into the context: the last filled row, the magnetic field there, and the formation pathway if a NS formed
+*
+* @param ctx context to fill
+*/
+static void bse_context_read_bcm(bse_context *ctx)
+{
+  int i=1;
+
+  ctx->bcm_formation_found = 0;
+  while (bse_get_bcm(i,1)>=0.0 && i < 50000) {
+    if (i > 1 && bse_get_bcm(i,2) == 13 && bse_get_bcm(i-1,2) < 13) {
+      if (bse_get_bcm(i+1,1) >= 0.0) {
+        ctx->bcm_formation = bse_get_bcm(i+1,35);
+      } else {
+        ctx->bcm_formation = bse_get_bcm(i,35);
+      }
+      ctx->bcm_formation_found = 1;
+    }
+    i++;
+  }
+  i--;
+  if (i+1 > 50000) {
+    i = 0;
+  }
+  ctx->nbcm = i;
+  if (i >= 1) {
+    ctx->bcm_B = bse_get_bcm(i,33);
+  }
+}
+
+/**
+* @brief takes the lock on the BSE COMMON blocks, saves the per-call values they currently hold into saved, and installs the ones from ctx
+*
+* @param ctx context to install
+* @param saved where the previous COMMON-block values are kept
+*/
+static void bse_common_enter(bse_context *ctx, bse_context *saved)
+{
+#ifdef USE_THREADS
+  pthread_mutex_lock(&bse_common_lock);
+#endif
+  saved->pts1 = points_.pts1;
+  saved->pts2 = points_.pts2;
+  saved->pts3 = points_.pts3;
+  saved->merger = cmcpass_.merger;
+  saved->id1_pass = cmcpass_.id1_pass;
+  saved->id2_pass = cmcpass_.id2_pass;
+
+  points_.pts1 = ctx->pts1;
+  points_.pts2 = ctx->pts2;
+  points_.pts3 = ctx->pts3;
+  cmcpass_.merger = ctx->merger;
+  cmcpass_.id1_pass = ctx->id1_pass;
+  cmcpass_.id2_pass = ctx->id2_pass;
+}
+
+/**
+* @brief restores the COMMON-block values saved by bse_common_enter() and releases the lock
+*
+* @param saved COMMON-block values to restore
+*/
+static void bse_common_leave(bse_context *saved)
+{
+  points_.pts1 = saved->pts1;
+  points_.pts2 = saved->pts2;
+  points_.pts3 = saved->pts3;
+  cmcpass_.merger = saved->merger;
+  cmcpass_.id1_pass = saved->id1_pass;
+  cmcpass_.id2_pass = saved->id2_pass;
+#ifdef USE_THREADS
+  pthread_mutex_unlock(&bse_common_lock);
+#endif
+}
+
+/**
+* @brief re-entrant version of bse_evolv2_safely: the per-call parameters and the rng state are taken from ctx instead of having been set through the COMMON-block setters. The COMMON blocks are installed from ctx and restored afterwards under a lock, so the call has no side effects visible to other callers.
+*
+* @param ctx per-call BSE state; rng and the bcm outputs are updated
+* @param kstar ?
+* @param mass0 ?
+* @param mass ?
+* @param rad ?
+* @param lum ?
+* @param massc ?
+* @param radc ?
+* @param menv ?
+* @param renv ?
+* @param ospin ?
+* @param B_0 ?
+* @param bacc ?
+* @param tacc ?
+* @param epoch ?
+* @param tms ?
+* @param tphys ?
+* @param tphysf ?
+* @param dtp ?
+* @param z ?
+* @param zpars ?
+* @param tb ?
+* @param ecc ?
+* @param vs ?
+*/
+void bse_evolv2_ctx(bse_context *ctx, int *kstar, double *mass0, double *mass, double *rad, double *lum,
+		    double *massc, double *radc, double *menv, double *renv, double *ospin,
+                    double *B_0, double *bacc, double *tacc,
+		    double *epoch, double *tms, double *tphys, double *tphysf, double *dtp,
+		    double *z, double *zpars, double *tb, double *ecc, double *vs, double *bhspin)
+{
+  bse_context saved;
+
+  bse_common_enter(ctx, &saved);
+  bse_set_taus113state(ctx->rng, 0);
+
+  bse_evolv2_safely(kstar, mass0, mass, rad, lum, massc, radc, menv, renv, ospin, B_0, bacc, tacc,
+		    epoch, tms, tphys, tphysf, dtp, z, zpars, tb, ecc, vs, bhspin);
+
+  ctx->rng = bse_get_taus113state();
+  bse_context_read_bcm(ctx);
+  bse_common_leave(&saved);
+}
+
+/**
+* @brief allocates the arrays of a batch of single stars
+*
+* @param batch batch to allocate
+* @param nmax maximum number of stars in the batch
+*/
+void bse_batch_alloc(bse_batch *batch, long nmax)
+{
+  batch->n = 0;
+  batch->nmax = nmax;
+  batch->idx = (long *) malloc(nmax * sizeof(long));
+  batch->id = (long *) malloc(nmax * sizeof(long));
+  batch->kw = (int *) malloc(nmax * sizeof(int));
+  batch->mass0 = (double *) malloc(nmax * sizeof(double));
+  batch->mass = (double *) malloc(nmax * sizeof(double));
+  batch->rad = (double *) malloc(nmax * sizeof(double));
+  batch->lum = (double *) malloc(nmax * sizeof(double));
+  batch->massc = (double *) malloc(nmax * sizeof(double));
+  batch->radc = (double *) malloc(nmax * sizeof(double));
+  batch->menv = (double *) malloc(nmax * sizeof(double));
+  batch->renv = (double *) malloc(nmax * sizeof(double));
+  batch->ospin = (double *) malloc(nmax * sizeof(double));
+  batch->B_0 = (double *) malloc(nmax * sizeof(double));
+  batch->bacc = (double *) malloc(nmax * sizeof(double));
+  batch->tacc = (double *) malloc(nmax * sizeof(double));
+  batch->epoch = (double *) malloc(nmax * sizeof(double));
+  batch->tms = (double *) malloc(nmax * sizeof(double));
+  batch->bhspin = (double *) malloc(nmax * sizeof(double));
+  batch->tphys = (double *) malloc(nmax * sizeof(double));
+  batch->pts1 = (double *) malloc(nmax * sizeof(double));
+  batch->vs = (double *) malloc(20 * nmax * sizeof(double));
+  batch->nbcm = (int *) malloc(nmax * sizeof(int));
+  batch->bcm_B = (double *) malloc(nmax * sizeof(double));
+  batch->bcm_formation_found = (int *) malloc(nmax * sizeof(int));
+  batch->bcm_formation = (double *) malloc(nmax * sizeof(double));
+}
+
+/**
+* @brief frees the arrays of a batch of single stars
+*
+* @param batch batch to free
+*/
+void bse_batch_free(bse_batch *batch)
+{
+  free(batch->idx); free(batch->id); free(batch->kw);
+  free(batch->mass0); free(batch->mass); free(batch->rad); free(batch->lum);
+  free(batch->massc); free(batch->radc); free(batch->menv); free(batch->renv);
+  free(batch->ospin); free(batch->B_0); free(batch->bacc); free(batch->tacc);
+  free(batch->epoch); free(batch->tms); free(batch->bhspin); free(batch->tphys);
+  free(batch->pts1); free(batch->vs);
+  free(batch->nbcm); free(batch->bcm_B); free(batch->bcm_formation_found); free(batch->bcm_formation);
+  batch->n = batch->nmax = 0;
+}
+
+/**
+* @brief evolves a batch of single stars, stored as arrays, up to time tphysf with a single call into the Fortran evolv1_batch, which loops over the stars itself. The COMMON blocks are installed once for the whole batch; per star only pts1 and the pass-through id change. The rng state is threaded through the stars in batch order starting from ctx->rng, and ctx->rng holds the final state on return. Results, birth kicks (vs, 20 per star) and the bcm quantities are written back into the batch arrays.
+*
+* @param ctx per-call BSE state shared by the batch
+* @param batch stars to evolve
+* @param tphysf time to evolve to
+* @param dtp output interval, as for bse_evolv2
+* @param z metallicity
+* @param zpars metallicity parameters
+*/
+void bse_evolv1_batch(bse_context *ctx, bse_batch *batch, double tphysf, double dtp, double *z, double *zpars)
+{
+  bse_context saved;
+  long i;
+  int n = (int) batch->n;
+
+  if (n == 0)
+    return;
+
+  bse_common_enter(ctx, &saved);
+  bse_set_taus113state(ctx->rng, 0);
+
+  evolv1_batch_(&n, batch->id, batch->pts1, batch->kw, batch->mass0, batch->mass, batch->rad, batch->lum,
+		batch->massc, batch->radc, batch->menv, batch->renv, batch->ospin, batch->B_0, batch->bacc,
+		batch->tacc, batch->epoch, batch->tms, batch->bhspin, batch->tphys, &tphysf, &dtp, z, zpars,
+		batch->vs, batch->nbcm, batch->bcm_B, batch->bcm_formation_found, batch->bcm_formation);
+
+  ctx->rng = bse_get_taus113state();
+  bse_common_leave(&saved);
+
+  /* the same sanity checks as bse_evolv2_safely() */
+  for (i=0; i<batch->n; i++) {
+    if (isnan(batch->rad[i]) || batch->mass[i] < 0.0 || batch->lum[i] < 0.0) {
+      fprintf(stderr, "bse_evolv1_batch(): unphysical result for id=%ld: tphys=%g tphysf=%g kstar=%d m0=%g m=%g r=%g l=%g\n",
+	      batch->id[i], batch->tphys[i], tphysf, batch->kw[i], batch->mass0[i], batch->mass[i], batch->rad[i], batch->lum[i]);
+    }
+  }
+}
+
 /**
 * @brief set collision matrix
 */
@@ -0,0 +1,131 @@
+***
+      SUBROUTINE evolv1_batch(n,id,pts1s,kw,mass0,mass,rad,lum,massc,
+     &                        radc,menv,renv,ospin,B_0,bacc,tacc,epoch,
+     &                        tms,bhspin,tphys,tphysf,dtp,z,zpars,vs,
+     &                        nbcm,bcmB,fmfound,fmtime)
+***
+*
+* Evolves n single stars, stored as arrays, up to tphysf in one call
+* from CMC. Each star is evolved with evolv2 as the primary of an
+* empty binary (kstar(2) = 15), as bse_evolv2_safely does for a
+* single star. Only pts1 and the id passed back to CMC change from
+* star to star; all other COMMON blocks are used as the caller set
+* them up, and the random number state runs on from one star to the
+* next. After each star the last filled row of bcm, the magnetic
+* field there, and the formation pathway of a NS formed during the
+* call are returned (nbcm, bcmB, fmfound, fmtime).
+*
+***
+      IMPLICIT NONE
+      INCLUDE 'const_bse.h'
+*
+      INTEGER n,i,j,k
+      INTEGER*8 id(n)
+      INTEGER kw(n),nbcm(n),fmfound(n),kstar(2)
+      REAL*8 pts1s(n),mass0(n),mass(n),rad(n),lum(n),massc(n),radc(n)
+      REAL*8 menv(n),renv(n),ospin(n),B_0(n),bacc(n),tacc(n),epoch(n)
+      REAL*8 tms(n),bhspin(n),tphys(n),vs(20,n),bcmB(n),fmtime(n)
+      REAL*8 tphysf,dtp,z,zpars(20)
+      REAL*8 m0b(2),mb(2),rb(2),lb(2),mcb(2),rcb(2),meb(2),reb(2)
+      REAL*8 osb(2),B0b(2),bab(2),tab(2),epb(2),tmb(2),bhb(2)
+      REAL*8 mytphysf,mydtp,tb,ecc,kick_info(2,17)
+*
+      id2_pass = 0
+      DO i = 1,n
+         pts1 = pts1s(i)
+         id1_pass = id(i)
+*
+         kstar(1) = kw(i)
+         kstar(2) = 15
+         m0b(1) = mass0(i)
+         mb(1) = mass(i)
+         rb(1) = rad(i)
+         lb(1) = lum(i)
+         mcb(1) = massc(i)
+         rcb(1) = radc(i)
+         meb(1) = menv(i)
+         reb(1) = renv(i)
+         osb(1) = ospin(i)
+         B0b(1) = B_0(i)
+         bab(1) = bacc(i)
+         tab(1) = tacc(i)
+         epb(1) = epoch(i)
+         tmb(1) = tms(i)
+         bhb(1) = bhspin(i)
+         m0b(2) = 0.d0
+         mb(2) = 0.d0
+         rb(2) = 0.d0
+         lb(2) = 0.d0
+         mcb(2) = 0.d0
+         rcb(2) = 0.d0
+         meb(2) = 0.d0
+         reb(2) = 0.d0
+         osb(2) = 0.d0
+         B0b(2) = 0.d0
+         bab(2) = 0.d0
+         tab(2) = 0.d0
+         epb(2) = 0.d0
+         tmb(2) = 0.d0
+         bhb(2) = 0.d0
+         tb = 0.d0
+         ecc = 0.d0
+         mytphysf = tphysf
+         mydtp = dtp
+*
+* evolv2 does not reset the kicks it returns
+         DO j = 1,20
+            vs(j,i) = 0.d0
+         ENDDO
+         DO j = 1,17
+            DO k = 1,2
+               kick_info(k,j) = 0.d0
+            ENDDO
+         ENDDO
+*
+         CALL evolv2(kstar,mb,tb,ecc,z,mytphysf,mydtp,m0b,rb,lb,mcb,
+     &               rcb,meb,reb,osb,B0b,bab,tab,epb,tmb,bhb,tphys(i),
+     &               zpars,vs(1,i),kick_info)
+*
+         kw(i) = kstar(1)
+         mass0(i) = m0b(1)
+         mass(i) = mb(1)
+         rad(i) = rb(1)
+         lum(i) = lb(1)
+         massc(i) = mcb(1)
+         radc(i) = rcb(1)
+         menv(i) = meb(1)
+         renv(i) = reb(1)
+         ospin(i) = osb(1)
+         B_0(i) = B0b(1)
+         bacc(i) = bab(1)
+         tacc(i) = tab(1)
+         epoch(i) = epb(1)
+         tms(i) = tmb(1)
+         bhspin(i) = bhb(1)
+*
+* Last filled row of bcm, and the formation pathway if a NS formed.
+         fmfound(i) = 0
+         fmtime(i) = 0.d0
+         bcmB(i) = 0.d0
+         j = 1
+         DO WHILE(bcm(j,1).ge.0.d0.and.j.lt.50000)
+            IF(j.gt.1.and.bcm(j,2).eq.13.d0.and.
+     &         bcm(j-1,2).lt.13.d0)THEN
+               IF(bcm(j+1,1).ge.0.d0)THEN
+                  fmtime(i) = bcm(j+1,35)
+               ELSE
+                  fmtime(i) = bcm(j,35)
+               ENDIF
+               fmfound(i) = 1
+            ENDIF
+            j = j + 1
+         ENDDO
+         j = j - 1
+         IF(j+1.gt.50000) j = 0
+         nbcm(i) = j
+         IF(j.ge.1) bcmB(i) = bcm(j,33)
+      ENDDO
+*
+      RETURN
+      END
+***
@@ -62,7 +62,6 @@ OPTIONS:
 int main(int argc, char *argv[])
 {
 	struct tms tmsbuf, tmsbufref;
-	long i;
 	gsl_rng *rng;
 	const gsl_rng_type *rng_type=gsl_rng_mt19937;
 
@@ -106,6 +105,9 @@ int main(int argc, char *argv[])
 	/* parse input parameter file, and read input data */
 	parser(argc, argv, rng);
 
+	/* MPI: node and leader communicators for the two-level collectives on the duplicated arrays */
+	node_comm_init(HIER_COLLECTIVES);
+
 	/* MPI: These variables are used for storing data partitioning related information in the parallel version. These arrays store the start and end indices in the global array that each processor is responsible for processing. In the serial version, these are used to mimic the parallel version to obtain comparable results. */
 	Start = (int *) calloc(procs, sizeof(int));
 	End = (int *) calloc(procs, sizeof(int));
@@ -213,18 +215,7 @@ int main(int argc, char *argv[])
 		//MPI: Apparently there are changes to the masses of the stars in stellar_evolution_init, so here before we start the timestep loop, we synchronize the mass array across all processors.
 		if (STELLAR_EVOLUTION > 0) {
 			mpiFindDispAndLenCustom( clus.N_MAX, MIN_CHUNK_SIZE, mpiDisp, mpiLen );
-
-			for(i=0;i<procs;i++)
-				mpiLen[i] *= sizeof(double); 
-
-			//MPI: Can be replaced by AllGatherv similar to the way it's done after sorting in post_sort_comm.
-			MPI_Status stat;
-			if(myid!=0)
-				MPI_Send(&star_m[mpiDisp[myid]], mpiLen[myid], MPI_BYTE, 0, 0, MPI_COMM_WORLD);
-			else
-				for(i=1;i<procs;i++)
-					MPI_Recv(&star_m[mpiDisp[i]], mpiLen[i], MPI_BYTE, i, 0, MPI_COMM_WORLD, &stat);
-			MPI_Bcast(star_m, clus.N_MAX+1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+			node_allgatherv(MPI_IN_PLACE, 0, star_m, mpiLen, mpiDisp, MPI_DOUBLE);
 		}
 		timeEndSimple(tmpTimeStart, &t_comm);
 	}
@@ -253,6 +244,9 @@ int main(int argc, char *argv[])
 		Ebescaped = 0.0;
 		TidalMassLoss = 0.0;
 		Etidal = 0.0;
+
+		/* neighbourhood averages are recomputed once per timestep */
+		local_env_invalidate();
 		timeEndSimple(tmpTimeStart, &t_oth);
 
 		/* calculate central quantities */
@@ -333,7 +327,10 @@ int main(int argc, char *argv[])
 		timeEndSimple(tmpTimeStart, &t_sort);
 
 		tmpTimeStart = timeStartSimple();
-		post_sort_comm();
+		if (POTENTIAL_PIPELINE_SEGMENTS > 0)
+			post_sort_comm_start();	/* completed while computing the potential */
+		else
+			post_sort_comm();
 		timeEndSimple(tmpTimeStart, &t_postsort_comm);
 
 		/* compute the potential */
@@ -350,30 +347,41 @@ int main(int argc, char *argv[])
 		energy_conservation3();
 		timeEndSimple(tmpTimeStart, &t_ener_con3);
 
-		tmpTimeStart = timeStartSimple();
-		comp_mass_percent();
-		timeEndSimple(tmpTimeStart, &t_calc_io_vars1);
-
-		tmpTimeStart = timeStartSimple();
-		comp_multi_mass_percent();
-		timeEndSimple(tmpTimeStart, &t_calc_io_vars2);
-
-		tmpTimeStart = timeStartSimple();
-		compute_energy_new();
-		timeEndSimple(tmpTimeStart, &t_comp_ener);
-
-		tmpTimeStart = timeStartSimple();
-		reset_interaction_flags();
-		timeEndSimple(tmpTimeStart, &t_oth);
-
-		/* update variables, then print */
-		tmpTimeStart = timeStartSimple();
-		update_vars();
-		timeEndSimple(tmpTimeStart, &t_upd_vars);
-
-		tmpTimeStart = timeStartSimple();
-		calc_clusdyn_new();
-		timeEndSimple(tmpTimeStart, &t_oth);
+		if (FUSED_DIAGNOSTICS) {
+			/* Lagrange radii, energies, binary totals and half-mass radius in one pass */
+			tmpTimeStart = timeStartSimple();
+			diagnostics_calculate();
+			timeEndSimple(tmpTimeStart, &t_calc_io_vars1);
+
+			tmpTimeStart = timeStartSimple();
+			reset_interaction_flags();
+			timeEndSimple(tmpTimeStart, &t_oth);
+		} else {
+			tmpTimeStart = timeStartSimple();
+			comp_mass_percent();
+			timeEndSimple(tmpTimeStart, &t_calc_io_vars1);
+
+			tmpTimeStart = timeStartSimple();
+			comp_multi_mass_percent();
+			timeEndSimple(tmpTimeStart, &t_calc_io_vars2);
+
+			tmpTimeStart = timeStartSimple();
+			compute_energy_new();
+			timeEndSimple(tmpTimeStart, &t_comp_ener);
+
+			tmpTimeStart = timeStartSimple();
+			reset_interaction_flags();
+			timeEndSimple(tmpTimeStart, &t_oth);
+
+			/* update variables, then print */
+			tmpTimeStart = timeStartSimple();
+			update_vars();
+			timeEndSimple(tmpTimeStart, &t_upd_vars);
+
+			tmpTimeStart = timeStartSimple();
+			calc_clusdyn_new();
+			timeEndSimple(tmpTimeStart, &t_oth);
+		}
 
 		if (WRITE_EXTRA_CORE_INFO) {
 			no_remnants= no_remnants_core(6);
@@ -401,6 +409,9 @@ int main(int argc, char *argv[])
 		if(CheckCheckpoint())
 			save_restart_file();
 
+		/* release the scratch arrays of this timestep */
+		scratch_reset();
+
 	} /* End time step iteration loop */
 
 	save_restart_file();
@@ -454,6 +465,8 @@ int main(int argc, char *argv[])
 	g_array_free(id_array, TRUE);
 #endif
 
+	halos_free();
+	node_comm_free();
 	MPI_Finalize();
 
 	return(0);
@@ -0,0 +1,140 @@
+/* vi: set filetype=c.doxygen: */
+
+/* Micro-benchmark of the flat and the two-level (node-aware) collectives used on the duplicated arrays:
+ * the Allgatherv of star_r/star_m in post_sort_comm(), the broadcast of the splitters and the gather of
+ * the sample keys in sample_sort(). The arrays are partitioned among the processes as in CMC, starting
+ * at index 1. Times are per call, the maximum over all processes.
+ *
+ * usage: mpirun -n <procs> cmc_bench_collectives [N [repetitions [samples per process]]] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+#include "cmc_node_comm.h"
+
+enum { BENCH_ALLGATHERV, BENCH_BCAST, BENCH_GATHER, BENCH_COUNT };
+static const char *bench_name[BENCH_COUNT] = { "Allgatherv", "Bcast", "Gather" };
+
+static int myid, procs;
+
+/**
+* @brief runs one collective, flat or through the two-level layer
+*/
+static void bench_run(int which, int hier, double *arr, double *part, int *cnt, int *displs, long N, int nsamp, double *samp, double *samp_all)
+{
+	switch (which) {
+	case BENCH_ALLGATHERV:
+		if (hier)
+			node_allgatherv(part, cnt[myid], arr, cnt, displs, MPI_DOUBLE);
+		else
+			MPI_Allgatherv(part, cnt[myid], MPI_DOUBLE, arr, cnt, displs, MPI_DOUBLE, MPI_COMM_WORLD);
+		break;
+	case BENCH_BCAST:
+		if (hier)
+			node_bcast(arr, (int) N+2, MPI_DOUBLE, 0);
+		else
+			MPI_Bcast(arr, (int) N+2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+		break;
+	case BENCH_GATHER:
+		if (hier)
+			node_gather(samp, nsamp, MPI_DOUBLE, samp_all, 0);
+		else
+			MPI_Gather(samp, nsamp, MPI_DOUBLE, samp_all, nsamp, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+		break;
+	}
+}
+
+/**
+* @brief checks that the result of one collective is complete and correct
+*
+* @return number of wrong elements on this process
+*/
+static long bench_check(int which, double *arr, long N, int nsamp, double *samp_all)
+{
+	long i, bad = 0;
+
+	if (which == BENCH_GATHER) {
+		if (myid == 0)
+			for (i=0; i<(long) procs*nsamp; i++)
+				bad += (samp_all[i] != (double) i);
+	} else {
+		for (i=1; i<=N; i++)
+			bad += (arr[i] != (double) i);
+	}
+	return(bad);
+}
+
+int main(int argc, char *argv[])
+{
+	long N = 1000000, i, bad;
+	int reps = 20, nsamp = 64, r, which, hier;
+	int *cnt, *displs;
+	double *arr, *part, *samp, *samp_all, t, times[BENCH_COUNT][2];
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+	MPI_Comm_size(MPI_COMM_WORLD, &procs);
+
+	if (argc > 1) N = atol(argv[1]);
+	if (argc > 2) reps = atoi(argv[2]);
+	if (argc > 3) nsamp = atoi(argv[3]);
+
+	node_comm_init(1);
+	if (myid == 0 && !node_comm_active())
+		printf("two-level layer inactive (single node, one process per node, or non-consecutive ranks); both columns are flat\n");
+
+	cnt = (int *) malloc(procs * sizeof(int));
+	displs = (int *) malloc(procs * sizeof(int));
+	for (r=0; r<procs; r++) {
+		cnt[r] = N / procs + (r < N % procs);
+		displs[r] = (r == 0) ? 1 : displs[r-1] + cnt[r-1];
+	}
+
+	arr = (double *) calloc(N+2, sizeof(double));
+	part = (double *) malloc((cnt[myid]+1) * sizeof(double));
+	for (i=0; i<cnt[myid]; i++)
+		part[i] = (double) (displs[myid] + i);
+	samp = (double *) malloc(nsamp * sizeof(double));
+	for (i=0; i<nsamp; i++)
+		samp[i] = (double) ((long) myid*nsamp + i);
+	samp_all = (double *) malloc((size_t) procs * nsamp * sizeof(double));
+
+	for (which=0; which<BENCH_COUNT; which++) {
+		for (hier=0; hier<2; hier++) {
+			if (which == BENCH_BCAST && myid == 0)
+				for (i=1; i<=N; i++)
+					arr[i] = (double) i;
+
+			/* warm up and check */
+			bench_run(which, hier, arr, part, cnt, displs, N, nsamp, samp, samp_all);
+			bad = bench_check(which, arr, N, nsamp, samp_all);
+			MPI_Allreduce(MPI_IN_PLACE, &bad, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+			if (bad && myid == 0)
+				fprintf(stderr, "%s (%s): %ld wrong elements\n", bench_name[which], hier ? "two-level" : "flat", bad);
+
+			MPI_Barrier(MPI_COMM_WORLD);
+			t = MPI_Wtime();
+			for (r=0; r<reps; r++)
+				bench_run(which, hier, arr, part, cnt, displs, N, nsamp, samp, samp_all);
+			t = (MPI_Wtime() - t) / reps;
+			MPI_Reduce(&t, &times[which][hier], 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+			for (i=0; i<=N+1; i++)
+				arr[i] = 0.0;
+		}
+	}
+
+	if (myid == 0) {
+		printf("N=%ld procs=%d repetitions=%d samples=%d\n", N, procs, reps, nsamp);
+		printf("%-12s %14s %14s %10s\n", "collective", "flat [ms]", "two-level [ms]", "speedup");
+		for (which=0; which<BENCH_COUNT; which++)
+			printf("%-12s %14.4f %14.4f %10.2f\n", bench_name[which], times[which][0]*1e3, times[which][1]*1e3,
+			       times[which][0]/times[which][1]);
+	}
+
+	free(cnt); free(displs); free(arr); free(part); free(samp); free(samp_all);
+	node_comm_free();
+	MPI_Finalize();
+
+	return(0);
+}
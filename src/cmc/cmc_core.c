@@ -29,9 +29,107 @@ static inline int is_member(int k, int* set, int len) {
 }
 
 
+/**
+ * @brief Casertano & Hut (1985) density estimator at this node's members of
+ * a radially sorted list of stars that is distributed over the nodes in the
+ * order of the slices (mpi version of the estimator).
+ *
+ * Since the positions and masses are in the duplicated arrays, the only
+ * thing that has to be exchanged is which stars are members near the slice
+ * boundaries: every node contributes its first and last n_points members to
+ * a single Allgather, from which the n_points/2 members to the left and the
+ * n_points members to the right of the local ones are picked. The density at
+ * member j is estimated from the n_points members around it, clamped at the
+ * ends of the list.
+ *
+ * @param idx global indices of this node's members, in increasing order
+ *
+ * @param nave number of members (counted from the first) at which the density
+ * is wanted
+ *
+ * @param nmem number of members on this node (at least nave); the ones beyond
+ * nave only enter the windows of the others
+ *
+ * @param n_points the number of points (stars) over which the local density
+ * is estimated
+ *
+ * @return The estimated densities at the first nave members. The array is
+ * borrowed from the scratch arena and must not be freed.
+ */
+double *density_slice(long *idx, long nave, long nmem, int n_points) {
+  long i, j, r, ibuf, nleft, nright, off, total_nmem;
+  long jmin, jmax;
+  double mrho, Vrj, *rho;
+
+  //MPI: Exchange the number of members and the first and last n_points of them.
+  long* nmem_all = (long*) malloc(procs * sizeof(long));
+  long* edge = (long*) malloc(2 * n_points * sizeof(long));
+  long* edge_all = (long*) malloc(2 * n_points * procs * sizeof(long));
+  for (j=0; j<n_points; j++) {
+    edge[j] = (j < nmem) ? idx[j] : -1;
+    edge[n_points+j] = (nmem-n_points+j >= 0) ? idx[nmem-n_points+j] : -1;
+  }
+
+  double tmpTimeStart = timeStartSimple();
+  MPI_Allgather(&nmem, 1, MPI_LONG, nmem_all, 1, MPI_LONG, MPI_COMM_WORLD);
+  MPI_Allgather(edge, 2*n_points, MPI_LONG, edge_all, 2*n_points, MPI_LONG, MPI_COMM_WORLD);
+  timeEndSimple(tmpTimeStart, &t_comm);
+
+  off = 0;
+  total_nmem = 0;
+  for (r=0; r<procs; r++) {
+    if (r < myid)
+      off += nmem_all[r];
+    total_nmem += nmem_all[r];
+  }
+
+  /* window of members: the halo to the left, the local ones, and the halo to the right */
+  long* win = (long*) scratch_alloc((nmem + n_points/2 + n_points) * sizeof(long));
+  nleft = 0;
+  for (r=myid-1; r>=0 && nleft<n_points/2; r--)
+    for (j=n_points-1; j>=0 && j>=n_points-nmem_all[r] && nleft<n_points/2; j--)
+      nleft++;
+  ibuf = nleft;
+  for (r=myid-1; r>=0 && ibuf>0; r--)
+    for (j=n_points-1; j>=0 && j>=n_points-nmem_all[r] && ibuf>0; j--)
+      win[--ibuf] = edge_all[2*n_points*r + n_points + j];
+  for (i=0; i<nmem; i++)
+    win[nleft+i] = idx[i];
+  nright = 0;
+  for (r=myid+1; r<procs && nright<n_points; r++)
+    for (j=0; j<n_points && j<nmem_all[r] && nright<n_points; j++)
+      win[nleft+nmem+(nright++)] = edge_all[2*n_points*r + j];
+
+  //MPI: Now we can do the computations for the local members.
+  rho = (double *) scratch_calloc(MAX(nave, 1), sizeof(double));
+  for (i=0; i<nave; i++) {
+    /* positions in the global list of members, shifted to the window */
+    jmin= MAX(off+i-n_points/2, 0);
+    jmax= MIN(jmin + n_points, total_nmem-1);
+    jmin-= off-nleft;
+    jmax-= off-nleft;
+    mrho= 0.;
+    /* this is equivalent to their J-1 factor for the case of equal masses,
+       and seems like a good generalization for unequal masses */
+    for (j=jmin+1; j<= jmax-1; j++) {
+      mrho+= star_m[win[j]] * madhoc;
+    }
+    Vrj = 4.0/3.0  * PI * (fb_cub(star_r[win[jmax]]) - fb_cub(star_r[win[jmin]]));
+
+    rho[i]= mrho/Vrj;
+  }
+
+  free(edge);
+  free(edge_all);
+  free(nmem_all);
+  return(rho);
+}
+
 /**
  * @brief Calculates density estimators including only stars with certain types. (mpi version of density_estimators)
  *
+ * Each node only estimates the densities at its own member stars within the
+ * half-mass radius of the members, with density_slice().
  *
  * @param n_points the number of points (stars) over which the local density
  * is estimated (Casertano & Hut '85 suggest n_points=6)
@@ -40,14 +138,13 @@ static inline int is_member(int k, int* set, int len) {
  *
  * @param len The length of the startype array.
  *
- * @return The array with the estimated local densities. The array is
- * malloc'ed so you have to free it yourself.
+ * @return The global indices of and the estimated local densities at this
+ * node's stars. The arrays are borrowed from the scratch arena and must not be freed.
  */
 struct densities density_estimators(int n_points, int *startypes, int len) {
-  long i, nave, ibuf;
-  double m, m_tot, mrho, Vrj;
+  long i, nave;
+  double m, m_tot;
   struct densities rhoj;
-  long jmin, jmax, j;
   long g_i;
   double m_cum;
 
@@ -69,99 +166,33 @@ struct densities density_estimators(int n_points, int *startypes, int len) {
   timeEndSimple(tmpTimeStart, &t_comm);
 
 
-  long* rhoj_idx= calloc(80, sizeof(long));
+  long* rhoj_idx= (long *) scratch_alloc(MAX(clus.N_MAX_NEW, 1) * sizeof(long));
 
   /* .. and now the number of non-remnants within their half-mass radius */
-  //MPI: Fill up the local rho idx array
+  //MPI: Fill up the local rho idx array with global indices
   m=m_cum;
-  nave= 0; i=1; ibuf=0;
+  nave= 0; i=1;
   while (m< 0.5*m_tot && i<=clus.N_MAX_NEW) {
     if (is_member(star[i].se_k, startypes, len)) {
         g_i = get_global_idx(i);
         m+= star_m[g_i]*madhoc;
-        rhoj_idx[nave]= i;
+        rhoj_idx[nave]= g_i;
         nave++;
-        ibuf++;
-        if (ibuf==80) {
-            rhoj_idx= (long *) realloc(rhoj_idx, sizeof(long)*(nave+80));
-            ibuf= 0;
-        }
     }
     i++;
   }
 
-  //MPI: Now, the idx array has to be corrected based on the last index of the previous processor.
-  long idx_cum = 0;
-  long idx_cum_s = 0;
-  if(nave > 0)
-      idx_cum_s = rhoj_idx[nave-1];
-
-  tmpTimeStart = timeStartSimple();
-  MPI_Exscan(&idx_cum_s, &idx_cum, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
-  timeEndSimple(tmpTimeStart, &t_comm);
-
-  for(i=0; i<nave; i++)
-  {
-      rhoj_idx[i] += idx_cum;
-  }
-
-  //MPI: The simplest way I could think of parallelizing this is by collecting the entire rho idx array. This is definitely inefficient and not scalable, but as of now we need a working solution. So, what follows is basically this - collecting chunks of the idx array from all the processors, putting them together and sending a copy to all nodes.
-  long* nave_all_long = (long*) malloc(procs * sizeof(long));
-  int* nave_all = (int*) malloc(procs * sizeof(long));
-  int* nave_disp = (int*) calloc(procs, sizeof(int));
-
-  //MPI: Gathering the size of the idx array from all processors .
-  tmpTimeStart = timeStartSimple();
-  MPI_Allgather(&nave, 1, MPI_LONG, nave_all_long, 1, MPI_LONG, MPI_COMM_WORLD);
-  timeEndSimple(tmpTimeStart, &t_comm);
-
-  //MPI: Calculating quantities required for the mpi call - displacement and count
-  long total_nave = 0;
-  int cum_disp=0;
-  for(i=0; i<procs; i++)
-  {
-      nave_all[i] = nave_all_long[i];
-      nave_disp[i] = cum_disp;
-      cum_disp += nave_all[i];
-  }
-  total_nave = cum_disp;
-
-  //MPI: Gathering all the idx chunks and sending the entire array to all processors.
-  rhoj.idx = (long*) malloc(total_nave * sizeof(long));
-  tmpTimeStart = timeStartSimple();
-  MPI_Allgatherv(rhoj_idx, nave, MPI_LONG, rhoj.idx, nave_all, nave_disp, MPI_LONG, MPI_COMM_WORLD);
-  timeEndSimple(tmpTimeStart, &t_comm);
-
-
-  //MPI: Now we can go back and do the computations independently on each node.
-  rhoj.rho = (double *) calloc(total_nave, sizeof(double));
-  rhoj.nave= total_nave;
-
-  for (i=0; i<rhoj.nave; i++) {
-    jmin= MAX(i-n_points/2, 0);
-    jmax= MIN(jmin + n_points, rhoj.nave-1);
-    mrho= 0.;
-    /* this is equivalent to their J-1 factor for the case of equal masses,
-       and seems like a good generalization for unequal masses */
-    for (j=jmin+1; j<= jmax-1; j++) {
-      mrho+= star_m[rhoj.idx[j]] * madhoc;
-    }
-    Vrj = 4.0/3.0  * PI * (fb_cub(star_r[rhoj.idx[jmax]]) - fb_cub(star_r[rhoj.idx[jmin]]));
-
-    rhoj.rho[i]= mrho/Vrj;
-  }
+  rhoj.idx = rhoj_idx;
+  rhoj.rho = density_slice(rhoj_idx, nave, nave, n_points);
+  rhoj.nave= nave;
 
-  free(rhoj_idx);
-  free(nave_all_long);
-  free(nave_all);
-  free(nave_disp);
   return(rhoj);
 }
 
 /**
 * @brief calculate core quantities using density weighted averages (note that in Casertano & Hut (1985) only rho and rc are analyzed and tested) (mpi version of core_properties)
 *
-* @param rhoj ?
+* @param rhoj local densities, as returned by density_estimators
 *
 * @return ?
 */
@@ -170,6 +201,7 @@ struct core_t core_properties(struct densities rhoj) {
   double rhoj2sum;
   struct core_t core;
   long idx, i;
+  double buf_reduce[5];
 
   rhojsum = 0.0;
   rhoj2sum = 0.0;
@@ -184,16 +216,23 @@ struct core_t core_properties(struct densities rhoj) {
     core.rho += sqr(rhoj.rho[i]);
     core.r += rhoj.rho[i] * star_r[idx];
     core.m_ave += rhoj.rho[i] * star_m[idx] * madhoc;
-    if( idx >= mpiBegin && idx <= mpiEnd )
-        core.v_rms += rhoj.rho[i] * (sqr(star[get_local_idx(idx)].vr) + sqr(star[get_local_idx(idx)].vt));
+    core.v_rms += rhoj.rho[i] * (sqr(star[get_local_idx(idx)].vr) + sqr(star[get_local_idx(idx)].vt));
   }
 
-  //MPI: Reducing only vrms, the other values dont have to be reduced.
-  double v_rms = core.v_rms;
+  //MPI: The densities are only known at the local stars, so all the sums are reduced.
+  buf_reduce[0] = rhojsum;
+  buf_reduce[1] = core.rho;
+  buf_reduce[2] = core.r;
+  buf_reduce[3] = core.m_ave;
+  buf_reduce[4] = core.v_rms;
   double tmpTimeStart = timeStartSimple();
-  MPI_Reduce(&core.v_rms, &v_rms, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, buf_reduce, 5, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
   timeEndSimple(tmpTimeStart, &t_comm);
-  core.v_rms = v_rms;
+  rhojsum = buf_reduce[0];
+  core.rho = buf_reduce[1];
+  core.r = buf_reduce[2];
+  core.m_ave = buf_reduce[3];
+  core.v_rms = buf_reduce[4];
 
   core.rho /= rhojsum;
   /* correction for inherent bias in estimator */
@@ -280,8 +319,6 @@ struct core_t no_remnants_core(int n_points) {
 
   rhoj= density_estimators(n_points, types, 11);
   core= core_properties(rhoj);
-  free(rhoj.idx);
-  free(rhoj.rho);
   return(core);
 }
 
@@ -0,0 +1,184 @@
+/* vi: set filetype=c.doxygen: */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cmc.h"
+#include "cmc_vars.h"
+
+/* Fused per-step diagnostics for FUSED_DIAGNOSTICS.  Computes the same
+ * quantities as comp_mass_percent(), comp_multi_mass_percent(),
+ * compute_energy_new(), update_vars() and calc_clusdyn_new(), but with two
+ * passes over the duplicated arrays, one pass over the local stars and a
+ * single MPI_Allreduce, and without any N-sized scratch arrays. */
+
+/* layout of the reduction buffer; the cumulative kinetic energies and v^2 at
+ * the Lagrange radii follow after DIAG_NFIXED */
+enum { DIAG_ETOT, DIAG_EK, DIAG_EP, DIAG_EINT, DIAG_EB, DIAG_MB, DIAG_BINEB, DIAG_NB, DIAG_NFIXED };
+
+/**
+* @brief computes the Lagrange radii (and quantities within them), the Lagrange radii of the mass bins, the half-mass radius, the energies and the binary totals in one go. Must be called at the point of the timestep where comp_mass_percent() would be called, and replaces it and the calls up to calc_clusdyn_new() except for reset_interaction_flags().
+*/
+void diagnostics_calculate(void)
+{
+	long i, k, g_i, nlocal, *lag_k, *mm_n;
+	int mcount, mstart, mend, b;
+	double mprev, mhalf, *buf, *lag, phi0, *mm_tot;
+	wquantile_t *mm_wq;
+
+	/* energies accumulated during the timestep, as in compute_energy_new() */
+	Eescaped += Eescaped_old;
+	Jescaped += Jescaped_old;
+	Eintescaped += Eintescaped_old;
+	Ebescaped += Ebescaped_old;
+	Etidal += Etidal_old;
+
+	/* Lagrange radii which are inside the central BH, as in comp_mass_percent() */
+	mprev = 0.0;
+	mstart = 0;
+	if (MASS_PC_BH_INCLUDE) {
+		mprev = cenma.m * madhoc;
+		for (mstart=0; mstart<MASS_PC_COUNT && mprev/Mtotal > mass_pc[mstart]; mstart++) {
+			mass_r[mstart] = MINIMUM_R;
+			ave_mass_r[mstart] = 0.0;
+			no_star_r[mstart] = 0;
+			densities_r[mstart] = 0.0;
+			ke_rad_r[mstart] = 0.0;
+			ke_tan_r[mstart] = 0.0;
+			v2_rad_r[mstart] = 0.0;
+			v2_tan_r[mstart] = 0.0;
+		}
+	}
+
+	/* first pass over the duplicated arrays: total mass and number of stars per mass bin */
+	mm_tot = (double *) calloc(MAX(NO_MASS_BINS, 1), sizeof(double));
+	mm_n = (long *) calloc(MAX(NO_MASS_BINS, 1), sizeof(long));
+	mm_wq = (wquantile_t *) malloc(MAX(NO_MASS_BINS, 1)*sizeof(wquantile_t));
+	if (NO_MASS_BINS > 1) {
+		for (i=1; i<=clus.N_MAX; i++) {
+			b = find_stars_mass_bin(star_m[i]/SOLAR_MASS_DYN);
+			if (b == -1) continue;
+			mm_tot[b] += star_m[i];
+			mm_n[b]++;
+		}
+		for (b=0; b<NO_MASS_BINS; b++)
+			wquantile_init(&mm_wq[b], MASS_PC_COUNT, mass_pc, multi_mass_r[b], mm_tot[b], mm_n[b]);
+	}
+
+	/* second pass: Lagrange radii, half-mass radius and mass-bin Lagrange radii */
+	lag_k = (long *) calloc(MAX(MASS_PC_COUNT, 1), sizeof(long));
+	mcount = mstart;
+	mhalf = 0.0;
+	k = 0;
+	for (i=1; i<=clus.N_MAX; i++) {
+		mprev += star_m[i] / clus.N_STAR;
+		if (mcount < MASS_PC_COUNT && mprev > mass_pc[mcount] * Mtotal) {
+			mass_r[mcount] = star_r[i];
+			ave_mass_r[mcount] = mprev/Mtotal/i*initial_total_mass;
+			no_star_r[mcount] = i;
+			densities_r[mcount] = mprev / (4.0 / 3.0 * PI * pow(star_r[i],3));
+			lag_k[mcount] = i;
+			mcount++;
+		}
+
+		if (k == 0) {
+			if (mhalf < 0.5 * Mtotal)
+				mhalf += star_m[i] / clus.N_STAR;
+			else
+				k = i;
+		}
+
+		if (NO_MASS_BINS > 1) {
+			b = find_stars_mass_bin(star_m[i]/SOLAR_MASS_DYN);
+			if (b == -1) continue;
+			wquantile_add(&mm_wq[b], star_r[i], star_m[i]);
+		}
+	}
+	mend = mcount;
+	clusdyn.rh = star_r[(k == 0) ? clus.N_MAX+1 : k];
+
+	for (b=0; b<NO_MASS_BINS && NO_MASS_BINS > 1; b++)
+		wquantile_finish(&mm_wq[b]);
+	free(mm_tot); free(mm_n); free(mm_wq);
+
+	/* pass over the local stars: E and J of each star, energies and binary totals,
+	   and this node's contribution to the cumulative sums up to each Lagrange radius */
+	buf = (double *) calloc(DIAG_NFIXED + 4*MAX(MASS_PC_COUNT, 1), sizeof(double));
+	lag = buf + DIAG_NFIXED;
+	phi0 = star_phi[0];
+	nlocal = mpiEnd-mpiBegin+1;
+	double ke_rad=0.0, ke_tan=0.0, v2_rad=0.0, v2_tan=0.0;
+	mcount = mstart;
+	for (i=1; i<=nlocal; i++) {
+		g_i = get_global_idx(i);
+		for (; mcount<mend && lag_k[mcount]<g_i; mcount++) {
+			lag[4*mcount] = ke_rad;
+			lag[4*mcount+1] = ke_tan;
+			lag[4*mcount+2] = v2_rad;
+			lag[4*mcount+3] = v2_tan;
+		}
+
+		star[i].E = star_phi[g_i] + 0.5 * (sqr(star[i].vr) + sqr(star[i].vt));
+		star[i].J = star_r[g_i] * star[i].vt;
+
+		ke_rad += 0.5 * star_m[g_i] * madhoc * star[i].vr * star[i].vr;
+		ke_tan += 0.5 * star_m[g_i] * madhoc * star[i].vt * star[i].vt;
+		v2_rad += star[i].vr * star[i].vr;
+		v2_tan += star[i].vt * star[i].vt;
+
+		buf[DIAG_EK] += 0.5 * (sqr(star[i].vr) + sqr(star[i].vt)) * star_m[g_i]*madhoc;
+		buf[DIAG_EP] += star_phi[g_i] * star_m[g_i]*madhoc;
+		buf[DIAG_EP] += phi0 * cenma.m*madhoc / clus.N_MAX;
+
+		k = star[i].binind;
+		if (k == 0) {
+			buf[DIAG_EINT] += star[i].Eint;
+		} else {
+			buf[DIAG_NB] += 1.0;
+			buf[DIAG_MB] += star_m[g_i];
+			if (binary[k].inuse) {
+				buf[DIAG_EB] += -(binary[k].m1*madhoc) * (binary[k].m2*madhoc) / (2.0 * binary[k].a);
+				buf[DIAG_EINT] += binary[k].Eint1 + binary[k].Eint2;
+				buf[DIAG_BINEB] += (binary[k].m1/clus.N_STAR) * (binary[k].m2/clus.N_STAR) / (2.0 * binary[k].a);
+			}
+		}
+	}
+	for (; mcount<mend; mcount++) {
+		lag[4*mcount] = ke_rad;
+		lag[4*mcount+1] = ke_tan;
+		lag[4*mcount+2] = v2_rad;
+		lag[4*mcount+3] = v2_tan;
+	}
+	buf[DIAG_EP] *= 0.5;
+	buf[DIAG_ETOT] = buf[DIAG_EK] + buf[DIAG_EP] + buf[DIAG_EINT] + buf[DIAG_EB];
+
+	double tmpTimeStart = timeStartSimple();
+	MPI_Allreduce(MPI_IN_PLACE, buf, DIAG_NFIXED + 4*MASS_PC_COUNT, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	timeEndSimple(tmpTimeStart, &t_comm);
+
+	for (mcount=mstart; mcount<mend; mcount++) {
+		ke_rad_r[mcount] = lag[4*mcount];
+		ke_tan_r[mcount] = lag[4*mcount+1];
+		v2_rad_r[mcount] = lag[4*mcount+2];
+		v2_tan_r[mcount] = lag[4*mcount+3];
+	}
+
+	Etotal.tot = buf[DIAG_ETOT];
+	Etotal.K = buf[DIAG_EK];
+	Etotal.P = buf[DIAG_EP];
+	Etotal.Eint = buf[DIAG_EINT];
+	Etotal.Eb = buf[DIAG_EB];
+
+	/* central BH energy was already communicated in post_sort_comm, as in ComputeEnergy() */
+	cenma.E += cenma.E_new;
+	cenma.E_new = 0.0;
+	Etotal.tot += cenma.E + Eescaped + Ebescaped + Eintescaped;
+
+	N_b = (long) (buf[DIAG_NB] + 0.5);
+	M_b = buf[DIAG_MB];
+	E_b = buf[DIAG_BINEB];
+
+	free(buf);
+	free(lag_k);
+}
@@ -8,6 +8,135 @@
 #include "cmc.h"
 #include "cmc_vars.h"
 
+/* fields of the relaxation batch, stored as one array each */
+enum { RB_M, RB_MP, RB_NLOCAL, RB_W, RB_DT, RB_RCM, RB_V1, RB_V2, RB_V3, RB_VP1, RB_VP2, RB_VP3,
+	RB_W1, RB_W2, RB_W3, RB_BETA, RB_PSI, RB_NF };
+
+/* single-single pairs whose two-body relaxation is deferred to relax_batch_apply() (RELAX_BATCH) */
+typedef struct {
+	long n, size;
+	long *k, *kp;
+	double *f[RB_NF];
+} relax_batch_t;
+
+/**
+* @brief queues the two-body relaxation of pair k, kp, with the quantities dynamics_apply() computed for it
+*/
+static void relax_batch_push(relax_batch_t *b, long k, long kp, double mass_k, double mass_kp, double n_local, double W, double dt, double rcm, double v[4], double vp[4], double w[4])
+{
+	long i;
+	int f;
+
+	if (b->n >= b->size) {
+		b->size = MAX(RELAX_BATCH, 1);
+		b->k = (long *) realloc(b->k, b->size * sizeof(long));
+		b->kp = (long *) realloc(b->kp, b->size * sizeof(long));
+		for (f=0; f<RB_NF; f++)
+			b->f[f] = (double *) realloc(b->f[f], b->size * sizeof(double));
+	}
+
+	i = b->n++;
+	b->k[i] = k;
+	b->kp[i] = kp;
+	b->f[RB_M][i] = mass_k;
+	b->f[RB_MP][i] = mass_kp;
+	b->f[RB_NLOCAL][i] = n_local;
+	b->f[RB_W][i] = W;
+	b->f[RB_DT][i] = dt;
+	b->f[RB_RCM][i] = rcm;
+	b->f[RB_V1][i] = v[1];
+	b->f[RB_V2][i] = v[2];
+	b->f[RB_V3][i] = v[3];
+	b->f[RB_VP1][i] = vp[1];
+	b->f[RB_VP2][i] = vp[2];
+	b->f[RB_VP3][i] = vp[3];
+	b->f[RB_W1][i] = w[1];
+	b->f[RB_W2][i] = w[2];
+	b->f[RB_W3][i] = w[3];
+}
+
+/**
+* @brief applies two-body relaxation to all queued pairs, as the scalar path in dynamics_apply() does for one pair, and empties the batch. The scattering angle statistics are accumulated into the arrays of dynamics_apply().
+*/
+static void relax_batch_apply(relax_batch_t *b, long *Nrel, long Nrelbeta[4], double relbeta[4], double qaverelbeta[4], double maverelbeta[4], double raverelbeta[4])
+{
+	long i, n = b->n;
+	int j;
+	double *m = b->f[RB_M], *mp = b->f[RB_MP], *W = b->f[RB_W], *beta = b->f[RB_BETA], *psi = b->f[RB_PSI];
+	double *v1 = b->f[RB_V1], *v2 = b->f[RB_V2], *v3 = b->f[RB_V3];
+	double *vp1 = b->f[RB_VP1], *vp2 = b->f[RB_VP2], *vp3 = b->f[RB_VP3];
+	double *w1 = b->f[RB_W1], *w2 = b->f[RB_W2], *w3 = b->f[RB_W3];
+	double Trel12, wp, cb, sb, cp, sp, dw1, dw2, dw3, q, qp;
+
+	/* random orientations of the deflection, drawn in one block */
+	for (i=0; i<n; i++)
+		psi[i] = rng_t113_dbl_new(curr_st) * 2 * PI;
+
+	/* deflection angles */
+	for (i=0; i<n; i++) {
+		Trel12 = (PI/32.0) * cub(W[i]) / ( ((double) clus.N_STAR) * b->f[RB_NLOCAL][i] * sqr((m[i]+mp[i])*madhoc) ) ;
+		beta[i] = (PI/2.0) * sqrt(b->f[RB_DT][i]/Trel12);
+	}
+
+	/* record statistics on scattering angles */
+	*Nrel += n;
+	for (i=0; i<n; i++) {
+		for (j=0; j<4; j++) {
+			if (beta[i] > relbeta[j]) {
+				Nrelbeta[j]++;
+				qaverelbeta[j] += MAX(m[i], mp[i])/MIN(m[i], mp[i]);
+				maverelbeta[j] += (m[i] + mp[i])/2.0 * units.mstar/MSUN;
+				raverelbeta[j] += b->f[RB_RCM][i];
+			}
+		}
+	}
+
+	for (i=0; i<n; i++) {
+		if (w1[i] == 0.0 && w2[i] == 0.0) {
+			eprintf("wp=0 \n");
+			exit_cleanly(1, __FUNCTION__);
+		}
+	}
+
+	/* new velocities, in the same coordinate system (w1, w2, w) as the scalar path; the v and vp
+	   fields are overwritten with them */
+	for (i=0; i<n; i++) {
+		/* clamp beta at max value */
+		beta[i] = MIN(beta[i], PI/2.0);
+		cb = cos(beta[i]);
+		sb = sin(beta[i]);
+		cp = cos(psi[i]);
+		sp = sin(psi[i]);
+		wp = sqrt(sqr(w1[i]) + sqr(w2[i]));
+
+		/* w_new - w, with w_new = w cos(beta) + \^w1 W sin(beta) cos(psi) + \^w2 W sin(beta) sin(psi) */
+		dw1 = w1[i] * (cb - 1.0) + (-w2[i] * W[i] / wp) * sb * cp + (-w1[i] * w3[i] / wp) * sb * sp;
+		dw2 = w2[i] * (cb - 1.0) + (w1[i] * W[i] / wp) * sb * cp + (-w2[i] * w3[i] / wp) * sb * sp;
+		dw3 = w3[i] * (cb - 1.0) + wp * sb * sp;
+
+		q = mp[i] / (m[i] + mp[i]);
+		qp = m[i] / (m[i] + mp[i]);
+		v1[i] -= q * dw1;
+		v2[i] -= q * dw2;
+		v3[i] -= q * dw3;
+		vp1[i] += qp * dw1;
+		vp2[i] += qp * dw2;
+		vp3[i] += qp * dw3;
+	}
+
+	/* set new velocities and energies of both stars */
+	for (i=0; i<n; i++) {
+		star[b->k[i]].vr = v3[i];
+		star[b->k[i]].vt = sqrt(sqr(v1[i]) + sqr(v2[i]));
+		star[b->kp[i]].vr = vp3[i];
+		star[b->kp[i]].vt = sqrt(sqr(vp1[i]) + sqr(vp2[i]));
+		set_star_EJ(b->k[i]);
+		set_star_EJ(b->kp[i]);
+	}
+
+	b->n = 0;
+}
+
 /**
 * @brief core of the code: applies relaxation, does single-single collisions and binary interactions
 *
@@ -34,8 +163,18 @@ void dynamics_apply(double dt, gsl_rng *rng)
 	double eta_min=MIN_BINARY_HARDNESS, Y1, rate_3bb, rate_ave=0.0, P_3bb, P_ave=0.0;
 	double clight10o7;
 	double collisions_multiple;
-
-    calc_sigma_r(AVEKERNEL, mpiEnd-mpiBegin+1, sigma_array.r, sigma_array.sigma, &(sigma_array.n), 0);
+	relax_batch_t rbatch = {0};
+
+    if (LOCAL_ENV_CACHE) {
+        local_env_calculate();
+        sigma_array.n = mpiEnd-mpiBegin+1;
+        for (si=1; si<=sigma_array.n; si++) {
+            sigma_array.r[si] = star_r[get_global_idx(si)];
+            sigma_array.sigma[si] = local_env.sigma[LENV_AVE][si];
+        }
+    } else {
+        calc_sigma_r(AVEKERNEL, mpiEnd-mpiBegin+1, sigma_array.r, sigma_array.sigma, &(sigma_array.n), 0);
+    }
 
     /* useful debugging and file headers */
     if (tcount == 1) {
@@ -107,19 +246,29 @@ void dynamics_apply(double dt, gsl_rng *rng)
 
 	if (THREEBODYBINARIES) { // Flag for turning on three-body binary formation
 		//MPI: Computing the average sigma and average local mass for each star and storing into arrays. In the original serial version by Meagan, these averages were computed as required inside the loop for each star, but for the parallel version it's simpler and more efficient if these were pre-computed and then just accessed from inside the loop.
-        double *ave_local_mass_arr = (double *) malloc( ((int)(clus.N_MAX_NEW+1)) * sizeof(double) );
-        double *sigma_local_arr = (double *) malloc( ((int)(clus.N_MAX_NEW+1)) * sizeof(double) );
+        double *ave_local_mass_arr, *sigma_local_arr;
         long temp; //the value in this is never used, but just for calc_sig function generalization.
 		  //MPI: This loop isn't identical to the actual serial loop (commented out below) which would ignore at most 2 stars (the last 2 which won't be able to undergo a 3bb interaction). However, parallelization would be more tricky, so here we fixed this the quick and dirty way - by skipping at most 2 stars in each processor.
 		  // Local density about star k1, nearest 20 stars (10 inside, 10 outside)
-        calc_sigma_r(BH_AVEKERNEL, clus.N_MAX_NEW, ave_local_mass_arr, sigma_local_arr, &temp, 1);
+        if (LOCAL_ENV_CACHE) {
+            //the cache was filled above and holds the average mass over the BH_AVEKERNEL window as well
+            ave_local_mass_arr = local_env.mave[LENV_BH];
+            sigma_local_arr = local_env.sigma[LENV_BH];
+        } else {
+            ave_local_mass_arr = (double *) scratch_alloc( ((int)(clus.N_MAX_NEW+1)) * sizeof(double) );
+            sigma_local_arr = (double *) scratch_alloc( ((int)(clus.N_MAX_NEW+1)) * sizeof(double) );
+            calc_sigma_r(BH_AVEKERNEL, clus.N_MAX_NEW, ave_local_mass_arr, sigma_local_arr, &temp, 1);
+        }
 		  for (sq=1; sq<=(mpiEnd-mpiBegin+1)-(mpiEnd-mpiBegin+1)%3-2; sq+=3) // loop through objects, 3 at a time
 			{
 				dt = SaveDt;
 				form_binary = 0; // reset this to zero; later we decide whether to form a binary, and if so, set form_binary=1
 				// Sort stars by mass (k1 is most massive)
 				sort_three_masses(sq, &k1, &k2, &k3);
-				n_local = calc_n_local(get_global_idx(k1), BH_AVEKERNEL, N_LIMIT);
+				if (LOCAL_ENV_CACHE)
+					n_local = local_env.n_local[LENV_BH][k1];
+				else
+					n_local = calc_n_local(get_global_idx(k1), BH_AVEKERNEL, N_LIMIT);
 				// If density above threshold, check for 3bb formation
 				if (n_local > n_threshold) {
 					// Are all stars singles? If not, exit loop - don't do binary formation
@@ -200,8 +349,6 @@ void dynamics_apply(double dt, gsl_rng *rng)
 					} 
 				}
 			} 
-		  free(ave_local_mass_arr);
-		  free(sigma_local_arr);
 	}
 			
 /***********************************************/	
@@ -230,6 +377,7 @@ are skipped if they already interacted in 3bb loop!  */
 
 		// only let those stars that did not participate in 3bb formation interact/relax
 		while (star[si].threebb_interacted == 1) {
+			star[si].t_relax = TotalTime; // counts as relaxed, so the step is not made up later
 			si += 1; // iterate until non-interacted object found
 		}
 
@@ -238,6 +386,7 @@ are skipped if they already interacted in 3bb loop!  */
 		si += 1;
 		while (star[si].threebb_interacted == 1) {
 		//	parafprintf(threebbfile, "star marked as threebb_interacted!\n");
+			star[si].t_relax = TotalTime;
 			si += 1; // iterate until non-interacted object found
 		}	
 		kp = si; // object 2 for interaction
@@ -247,12 +396,25 @@ are skipped if they already interacted in 3bb loop!  */
 		g_k = get_global_idx(k);
 		g_kp = get_global_idx(kp);
 
+		/* with block timesteps, the pair takes the level of its inner star, and is only
+		   relaxed when that level is due, over the mean time elapsed since its two stars
+		   were last relaxed (stars change level, so this is kept per star) */
+		if (!block_timestep_due(star_r[g_k]))
+			continue;
+		if (BLOCK_TIMESTEP_LEVELS > 1)
+			dt = TotalTime - 0.5 * (star[k].t_relax + star[kp].t_relax);
+		star[k].t_relax = TotalTime;
+		star[kp].t_relax = TotalTime;
+
 		/* set dynamical params for this pair */
 		calc_encounter_dyns(k, kp, v, vp, w, &W, &rcm, vcm, rng, 1);
 
 		//MPI: Makes use of r values of stars outside range. Assuming r array is global, no change needed for MPI version.
 		/* Compute local density */
-		n_local = calc_n_local(g_k, p, N_LIMIT);
+		if (LOCAL_ENV_CACHE && k <= local_env.n)
+			n_local = local_env.n_local[LENV_AVE][k];
+		else
+			n_local = calc_n_local(g_k, p, N_LIMIT);
 	
 		mass_k = star_m[g_k];
 		mass_kp = star_m[g_kp];
@@ -416,7 +578,10 @@ are skipped if they already interacted in 3bb loop!  */
 
 		/* calculate encounter probability */
 		/* should it be n_local here even for binaries? */
-		P_enc = n_local * W * S * (dt * ((double) clus.N_STAR)/log(GAMMA*((double) clus.N_STAR)));
+		/* a pair relaxed over several block timesteps still samples encounters over no more
+		   than the global encounter limit (or the step, if that is longer), so P_enc stays
+		   as far below 1 as for a single step */
+		P_enc = n_local * W * S * (MIN(dt, MAX(SaveDt, DTenc)) * ((double) clus.N_STAR)/log(GAMMA*((double) clus.N_STAR)));
 		
 		/* warn if something went wrong with the calculation of Dt */
 		if (P_enc >= 1.0) {
@@ -445,6 +610,11 @@ are skipped if they already interacted in 3bb loop!  */
 				sscollision_do(k, kp, rperi, w, W, rcm, vcm, rng);
 				/* parafprintf(collisionfile, "SS %g %g\n", TotalTime, rcm); */
 			}
+		} else if (RELAXATION && RELAX_BATCH > 0 && star[k].binind == 0 && star[kp].binind == 0 && !(cenma.m > 0.0 && BH_LOSS_CONE)) {
+			/* single--single two-body relaxation, done in blocks */
+			relax_batch_push(&rbatch, k, kp, mass_k, mass_kp, n_local, W, dt, rcm, v, vp, w);
+			if (rbatch.n >= RELAX_BATCH)
+				relax_batch_apply(&rbatch, &Nrel, Nrelbeta, relbeta, qaverelbeta, maverelbeta, raverelbeta);
 		} else if (RELAXATION) {
 			/* do two-body relaxation */
 			Trel12 = (PI/32.0) * cub(W) / ( ((double) clus.N_STAR) * n_local * sqr((mass_k+mass_kp)*madhoc) ) ;
@@ -519,6 +689,19 @@ are skipped if they already interacted in 3bb loop!  */
 		}
 	}
 
+	/* the unpaired star at the end, if its level is due, loses this step as it always has */
+	for (; si<=mpiEnd-mpiBegin+1; si++)
+		if (block_timestep_due(star_r[get_global_idx(si)]))
+			star[si].t_relax = TotalTime;
+
+	/* relax the pairs still queued */
+	if (rbatch.n > 0)
+		relax_batch_apply(&rbatch, &Nrel, Nrelbeta, relbeta, qaverelbeta, maverelbeta, raverelbeta);
+	free(rbatch.k);
+	free(rbatch.kp);
+	for (i=0; i<RB_NF; i++)
+		free(rbatch.f[i]);
+
     //MPI: Reduction for File IO - relaxationfile
 	double tmpTimeStart = timeStartSimple();
     double buf_comm_dbl[3][4];
@@ -70,6 +70,7 @@ void zero_star(long j)
 	star[j].se_renv = 0.0;
 	star[j].se_tms = 0.0;
 	star[j].se_bhspin = 0.0;
+	star[j].se_tnext = 0.0;
 }
 
 /**
@@ -172,6 +173,148 @@ void destroy_obj_new(long i)
 	star[i].vtnew = 0.0;		/*		future calculations  */
 }
 
+/* bitmap of the binary slots in use, so create_binary() finds the first free slot without scanning the
+   binary array; reset after every sort, and rebuilt from the inuse flags lazily after loading. bin_slots_end
+   is one past the highest slot that may be in use, so that sample_sort() only has to clear the live range. */
+static unsigned long *bin_slots = NULL;
+static long bin_slots_n = 0, bin_slots_words = 0, bin_slots_hint = 0, bin_slots_end = 0;
+#define BIN_SLOT_BITS ((long) (8 * sizeof(unsigned long)))
+
+/**
+* @brief (re)allocates the bitmap of used binary slots, with only slot 0 and the padding past the end of the array marked as used
+*/
+static void binary_slots_init(void)
+{
+	long i;
+
+	bin_slots_n = N_BIN_DIM_OPT;
+	bin_slots_words = (bin_slots_n + BIN_SLOT_BITS - 1) / BIN_SLOT_BITS;
+	bin_slots = (unsigned long *) realloc(bin_slots, bin_slots_words * sizeof(unsigned long));
+	memset(bin_slots, 0, bin_slots_words * sizeof(unsigned long));
+
+	bin_slots[0] |= 1UL;
+	for (i=bin_slots_n; i<bin_slots_words*BIN_SLOT_BITS; i++)
+		bin_slots[i / BIN_SLOT_BITS] |= 1UL << (i % BIN_SLOT_BITS);
+
+	bin_slots_hint = 0;
+	bin_slots_end = 1;
+}
+
+/**
+* @brief rebuilds the bitmap of used binary slots from the inuse flags of the binary array. Slot 0 is never used.
+*/
+void binary_slots_rebuild(void)
+{
+	long i;
+
+	binary_slots_init();
+	for (i=1; i<bin_slots_n; i++)
+		if (binary[i].inuse) {
+			bin_slots[i / BIN_SLOT_BITS] |= 1UL << (i % BIN_SLOT_BITS);
+			bin_slots_end = i + 1;
+		}
+}
+
+/**
+* @brief resets the bitmap of used binary slots after the binaries were repacked into slots 1 to n, with all slots above n cleared
+*
+* @param n number of binaries in use
+*/
+void binary_slots_reset(long n)
+{
+	long i;
+
+	binary_slots_init();
+	n = MIN(n, bin_slots_n-1);
+	for (i=0; i<(n+1)/BIN_SLOT_BITS; i++)
+		bin_slots[i] = ~0UL;
+	if ((n+1) % BIN_SLOT_BITS)
+		bin_slots[i] |= (1UL << ((n+1) % BIN_SLOT_BITS)) - 1UL;
+
+	bin_slots_hint = (n+1) / BIN_SLOT_BITS;
+	bin_slots_end = n + 1;
+}
+
+/**
+* @brief the live range of the binary array
+*
+* @return one past the highest binary slot that may be in use
+*/
+long binary_slots_live_end(void)
+{
+	if (bin_slots == NULL)
+		binary_slots_rebuild();
+
+	return(bin_slots_end);
+}
+
+/**
+* @brief extends the bitmap of used binary slots after the binary array has grown, keeping the slots in use
+*/
+static void binary_slots_extend(void)
+{
+	long i, old_n = bin_slots_n, old_words = bin_slots_words;
+
+	/* the padding past the old end of the array becomes free slots */
+	for (i=old_n; i<old_words*BIN_SLOT_BITS; i++)
+		bin_slots[i / BIN_SLOT_BITS] &= ~(1UL << (i % BIN_SLOT_BITS));
+
+	bin_slots_n = N_BIN_DIM_OPT;
+	bin_slots_words = (bin_slots_n + BIN_SLOT_BITS - 1) / BIN_SLOT_BITS;
+	bin_slots = (unsigned long *) realloc(bin_slots, bin_slots_words * sizeof(unsigned long));
+	memset(bin_slots + old_words, 0, (bin_slots_words - old_words) * sizeof(unsigned long));
+	for (i=bin_slots_n; i<bin_slots_words*BIN_SLOT_BITS; i++)
+		bin_slots[i / BIN_SLOT_BITS] |= 1UL << (i % BIN_SLOT_BITS);
+
+	bin_slots_hint = old_n / BIN_SLOT_BITS;
+}
+
+/**
+* @brief takes the lowest free binary slot, i.e. the one a scan for the first binary not in use would find. The binary array is grown if it is full.
+*
+* @return index of the slot
+*/
+static long binary_slot_alloc(void)
+{
+	long w, i;
+	int b;
+
+	if (bin_slots == NULL)
+		binary_slots_rebuild();
+
+	for (;;) {
+		for (w=bin_slots_hint; w<bin_slots_words; w++) {
+			while (bin_slots[w] != ~0UL) {
+				b = __builtin_ctzl(~bin_slots[w]);
+				bin_slots[w] |= 1UL << b;
+				i = w * BIN_SLOT_BITS + b;
+				/* a slot filled without going through create_binary() is just marked, and skipped */
+				if (!binary[i].inuse) {
+					bin_slots_hint = w;
+					bin_slots_end = MAX(bin_slots_end, i+1);
+					return(i);
+				}
+			}
+		}
+
+		/* no free slot left */
+		binary_array_reserve(bin_slots_n + 1);
+		binary_slots_extend();
+	}
+}
+
+/**
+* @brief returns binary slot i to the free slots
+*
+* @param i index of binary
+*/
+static void binary_slot_free(long i)
+{
+	if (bin_slots == NULL || i <= 0 || i >= bin_slots_n) return;
+	bin_slots[i / BIN_SLOT_BITS] &= ~(1UL << (i % BIN_SLOT_BITS));
+	bin_slots_hint = MIN(bin_slots_hint, i / BIN_SLOT_BITS);
+}
+
 /**
 * @brief destroy a binary
 *
@@ -181,6 +324,7 @@ void destroy_binary(long i)
 {
 	/* set inuse flag to zero, and zero out all other properties for safety */
 	zero_binary(i);
+	binary_slot_free(i);
 	dprintf("Binary %ld with id1=%ld id2=%ld destroyed!\n", i, binary[i].id1, binary[i].id2);
 	N_b_local--;
 }
@@ -204,16 +348,21 @@ long create_star(int idx, int dyn_0_se_1)
 
 	i = clus.N_MAX_NEW;
 
+	/* room for the new star and the sentinel after it */
+	star_array_reserve(i + 2);
+
 	dprintf("star created!!!, idx=%ld by star idx=%d\ton node=%d,\tdyn_or_se=%d\t\n", i, idx, myid, dyn_0_se_1);
 
 	/* initialize to zero for safety */
 	zero_star(i);
+	/* a new star has nothing left to be relaxed over */
+	star[i].t_relax = TotalTime;
 	
 	return(i);
 }
 
 /**
-* @brief create a new binary, returning its index. A new binary creation is done as follows. Since binaries get destroyed, so, first we scan the existing binary array and look for holes i.e. which were left behind by destroyed stars. If one is found, we insert a new binary there, if not we insert it at the end.
+* @brief create a new binary, returning its index. A new binary creation is done as follows. Since binaries get destroyed, so, first we look for holes in the binary array i.e. which were left behind by destroyed stars, using the bitmap of used slots. If one is found, we insert a new binary in the first one, if not the binary array is grown and we insert it at the end.
 *
 * @param idx index of the star that is creating the binary
 * @param dyn_0_se_1 0 if created by dynamics, 1 if created by stellar evolution
@@ -224,17 +373,8 @@ long create_binary(int idx, int dyn_0_se_1)
 {
 	long i, j;
 	
-	/* find first free binary */
-	i = 1;
-	while (i <= N_BIN_DIM && binary[i].inuse) {
-		i++;
-	}
-
-	/* problem! */
-	if (i > N_BIN_DIM) {
-		eprintf("cannot find unused binary.\n");
-		exit_cleanly(1, __FUNCTION__);
-	}
+	/* find first free binary, growing the binary array if needed */
+	i = binary_slot_alloc();
 
 	dprintf("HOLE FOUND at %ld\t INSERTING STAR %d\n", i, idx);
 
@@ -2518,6 +2658,12 @@ void binint_do(long k, long kp, double rperi, double w[4], double W, double rcm,
 	fb_free_hier(hier);
 }
 
+/* relaxation timesteps of the blocks of simul_relax_new() in the current step, used for the block timesteps */
+static struct {
+	long n, size;
+	double *dt, *r;
+} rel_blocks;
+
 /**
 * @brief Parallel version of simul_relax_new
 *
@@ -2531,35 +2677,48 @@ double simul_relax_new(void)
 
 	N_LIMIT = clus.N_MAX;
 	p = AVEKERNEL; //For this value, the results are very close to the original simul_relax() function.
+	rel_blocks.n = 0;
 
 	//MPI: Earlier the divion of stars among processors for this part was different, (and was similar to the original simul_relax function), and the one for the main code was different. But, in that case this function required communication with neighbors. So, it was changed such that both the main code and this function use the same kind of division of stars among processors. Now, stars are divided in sets of AVEKERNEL which is typically set to MIN_CHUNK_SIZE to avoid communication caused due to this function.
 	//for (si=mpiBegin+p; si<mpiEnd-p; si+=2*p) {
+	if (LOCAL_ENV_CACHE)
+		local_env_calculate();
+
 	for (si=1+p; si<mpiEnd-mpiBegin+1-p; si+=2*p) {
-		simin = si - p;
-		simax = simin + (2 * p - 1);
+		if (LOCAL_ENV_CACHE) {
+			/* the block around si is the cached window of si, which never touches the ends of the cluster here */
+			Mv2ave = local_env.mv2ave[LENV_AVE][si];
+			Mave = local_env.mave[LENV_AVE][si];
+			M2ave = local_env.m2ave[LENV_AVE][si];
+			sigma = local_env.sigma[LENV_AVE][si];
+			n_local = local_env.n_local[LENV_AVE][si];
+		} else {
+			simin = si - p;
+			simax = simin + (2 * p - 1);
 
-		Mv2ave = 0.0;
-		Mave = 0.0;
-		M2ave = 0.0;
-		for (k=simin; k<=simax; k++) {
-			j = get_global_idx(k);
-			double tmp = star_m[j] * madhoc;
-			Mv2ave += tmp * (sqr(star[k].vr) + sqr(star[k].vt));
-			Mave += tmp;
-			M2ave += sqr(tmp);
+			Mv2ave = 0.0;
+			Mave = 0.0;
+			M2ave = 0.0;
+			for (k=simin; k<=simax; k++) {
+				j = get_global_idx(k);
+				double tmp = star_m[j] * madhoc;
+				Mv2ave += tmp * (sqr(star[k].vr) + sqr(star[k].vt));
+				Mave += tmp;
+				M2ave += sqr(tmp);
+			}
+			//OPT: Remove double?
+			Mv2ave /= (double) (2 * p);
+			Mave /= (double) (2 * p);
+			M2ave /= (double) (2 * p);
+			
+			/* sigma is the 3D velocity dispersion */
+			sigma = sqrt(Mv2ave/Mave);
+
+			/* Compute local density */
+			n_local = calc_n_local(get_global_idx(si), p, clus.N_MAX);
 		}
-		//OPT: Remove double?
-		Mv2ave /= (double) (2 * p);
-		Mave /= (double) (2 * p);
-		M2ave /= (double) (2 * p);
-		
-		/* sigma is the 3D velocity dispersion */
-		sigma = sqrt(Mv2ave/Mave);
 		/* average relative speed for a Maxwellian, from Binney & Tremaine */
 		W = 4.0 * sigma / sqrt(3.0 * PI);
-
-		/* Compute local density */
-		n_local = calc_n_local(get_global_idx(si), p, clus.N_MAX);
 		
 		/* remember that code time units are t_cross * N/log(GAMMA*N) */
 		/* this expression is from Freitag & Benz (2001), eqs. (8) and (9), we're just
@@ -2569,6 +2728,18 @@ double simul_relax_new(void)
 			cub(W) / ( ((double) clus.N_STAR) * n_local * (4.0 * M2ave) );
 
 		dtmin = MIN(dtmin, dt);
+
+		/* remember the block's timestep and outer radius for block_timestep_calculate() */
+		if (BLOCK_TIMESTEP_LEVELS > 1) {
+			if (rel_blocks.n >= rel_blocks.size) {
+				rel_blocks.size = MAX(2 * rel_blocks.size, 64);
+				rel_blocks.dt = (double *) realloc(rel_blocks.dt, rel_blocks.size * sizeof(double));
+				rel_blocks.r = (double *) realloc(rel_blocks.r, rel_blocks.size * sizeof(double));
+			}
+			rel_blocks.dt[rel_blocks.n] = dt;
+			rel_blocks.r[rel_blocks.n] = star_r[get_global_idx(si + p - 1)];
+			rel_blocks.n++;
+		}
 	}
 
 	double tmpTimeStart = timeStartSimple();
@@ -2578,6 +2749,53 @@ double simul_relax_new(void)
 	return(DTrel);
 }
 
+/**
+* @brief Sets up the block timesteps (BLOCK_TIMESTEP_LEVELS) for the current step, once the global timestep is known. Level L starts outside the outermost block of simul_relax_new() whose relaxation timestep is below 2^L Dt, so every star is relaxed over at most its local relaxation timestep. Level L is due every 2^L steps. Since stars move between levels, the time a star is relaxed over is kept per star (star_t::t_relax) rather than per level.
+*
+* @param Dt global timestep of the current step
+*/
+void block_timestep_calculate(double Dt)
+{
+	long i;
+	int L, nlev = MIN(BLOCK_TIMESTEP_LEVELS, BLOCK_TIMESTEP_MAX);
+
+	for (L=0; L<nlev; L++)
+		block_r[L] = -GSL_POSINF;
+	/* without the relaxation timestep estimate there is nothing to set the levels by */
+	if (!(RELAXATION || FORCE_RLX_STEP)) {
+		for (L=1; L<nlev; L++)
+			block_r[L] = GSL_POSINF;
+	}
+	for (i=0; i<rel_blocks.n; i++)
+		for (L=1; L<nlev; L++)
+			if (rel_blocks.dt[i] < ((double) (1L << L)) * Dt)
+				block_r[L] = MAX(block_r[L], rel_blocks.r[i]);
+
+	double tmpTimeStart = timeStartSimple();
+	MPI_Allreduce(MPI_IN_PLACE, block_r, nlev, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	timeEndSimple(tmpTimeStart, &t_comm);
+
+	for (L=0; L<nlev; L++)
+		block_due[L] = (tcount % (1L << L) == 0);
+}
+
+/**
+* @brief whether a star at radius r is relaxed and evolved in the current step under the block timesteps. Always true when BLOCK_TIMESTEP_LEVELS is off.
+*
+* @param r radial position of the star
+*
+* @return 1 if the star's level is due in this step, 0 otherwise
+*/
+int block_timestep_due(double r)
+{
+	int L, nlev = MIN(BLOCK_TIMESTEP_LEVELS, BLOCK_TIMESTEP_MAX);
+
+	if (nlev <= 1) return 1;
+
+	for (L=nlev-1; L>0 && r <= block_r[L]; L--);
+	return block_due[L];
+}
+
 /**
 * @brief simulate relaxation to get timestep (original serial version). Calculates timestep for each star using some average quantities taken around the star, and then returns the minimum of these.
 *
@@ -2808,8 +3026,104 @@ void break_wide_binaries(struct rng_t113_state* rng_st)
 	Eoops += -Eexcess;
 }
 
+/* persistent ghost exchanges of calc_sigma_r(), one per kernel size in use, and of local_env_calculate() */
+static mpi_halo_t sigma_halo[2], local_env_halo;
+
 /**
-* @brief Computes the local average velocity dispersion value for each star (parallel version of calc_sigma_r).
+* @brief releases the persistent ghost exchanges of calc_sigma_r() and local_env_calculate(); must be called before MPI_Finalize()
+*/
+void halos_free(void)
+{
+	mpiHaloFree(&sigma_halo[0]);
+	mpiHaloFree(&sigma_halo[1]);
+	mpiHaloFree(&local_env_halo);
+}
+
+/**
+* @brief sliding window of calc_sigma_r() around local star si, clamped at the ends of the cluster
+*
+* @param si local index of star
+* @param p the window to be averaged over
+* @param N_LIMIT total number of stars in the processor
+* @param simin first local index of the window (may be < 1, i.e. a ghost star)
+* @param simax last local index of the window (may be > N_LIMIT, i.e. a ghost star)
+*/
+static void sigma_window(long si, long p, long N_LIMIT, long *simin, long *simax)
+{
+	//Also find the global index to figure out special cases
+	int g_si = get_global_idx(si);
+
+	*simin = si - p;
+	*simax = *simin + (2 * p - 1);
+
+	if (g_si - p < 1) {
+		//Special case for the root node
+		*simin = 1;
+		*simax = *simin + (2 * p - 1);
+	} else if (g_si - p + (2 * p - 1) > clus.N_MAX) {
+		//Special case for the last node
+		*simax = N_LIMIT;
+		*simin = *simax - (2 * p - 1);
+	}
+}
+
+/**
+* @brief v^2 of local star k, or of a ghost star from the halo. The halo holds the p vr values followed by the p vt values of the neighbouring processor's edge.
+*/
+static double sigma_v2(long k, long p, long N_LIMIT, mpi_halo_t *h)
+{
+	if (k > N_LIMIT)
+		return sqr(h->recv_next[k-N_LIMIT-1]) + sqr(h->recv_next[p+k-N_LIMIT-1]);
+	if (k < 1)
+		return sqr(h->recv_prev[k+p-1]) + sqr(h->recv_prev[p+k+p-1]);
+	return sqr(star[k].vr) + sqr(star[k].vt);
+}
+
+/**
+* @brief sliding-window sweep of calc_sigma_r() over local stars from..to
+*/
+static void sigma_sweep(long from, long to, long p, long N_LIMIT, mpi_halo_t *h, double *sig_r_or_mave, double *sig_sigma, int r_0_mave_1)
+{
+	long si, k, simin, simax, lo, hi;
+	double Mv2ave=0.0, Mave=0.0, m;
+
+	if (from > to) return;
+	sigma_window(from, p, N_LIMIT, &lo, &hi);
+	hi = lo - 1;
+
+	for (si=from; si<=to; si++) {
+		sigma_window(si, p, N_LIMIT, &simin, &simax);
+
+		// do sliding sum
+		for (k=lo; k<simin; k++) {
+			//MPI: Using a direct expression instead of get_global_idx() since it was changed to return the global index for stars outside local subset.
+			/*MPI: Using the global mass array*/
+			m = star_m[Start[myid] + k - 1] * madhoc;
+			Mv2ave -= m * sigma_v2(k, p, N_LIMIT, h);
+			Mave -= m;
+		}
+		for (k=hi+1; k<=simax; k++) {
+			m = star_m[Start[myid] + k - 1] * madhoc;
+			Mv2ave += m * sigma_v2(k, p, N_LIMIT, h);
+			Mave += m;
+		}
+
+		/* Storing r or average mass based on input parameter */
+		if(r_0_mave_1 == 0)
+			sig_r_or_mave[si] = star_r[get_global_idx(si)];
+		else
+			sig_r_or_mave[si] = Mave/2./p;
+
+		/* store sigma (sigma is the 3D velocity dispersion) */
+		sig_sigma[si] = sqrt(Mv2ave/Mave);
+
+		lo = simin;
+		hi = simax;
+	}
+}
+
+/**
+* @brief Computes the local average velocity dispersion value for each star (parallel version of calc_sigma_r). The ghost particles are exchanged with a persistent nonblocking halo, and the windows which need no ghost particles are computed while the exchange is in flight. Each of the three sweeps starts its sliding sums afresh, so sigma differs in the last bits from a single sweep over all stars (and so do the random walks that use it); carrying the sums across would need the ghost particles before the interior sweep.
 *
 * @param p the window to be averaged over
 * @param N_LIMIT total number of stars in the processor
@@ -2820,171 +3134,156 @@ void break_wide_binaries(struct rng_t113_state* rng_st)
 */
 void calc_sigma_r(long p, long N_LIMIT, double *sig_r_or_mave, double *sig_sigma, long* sig_n, int r_0_mave_1)
 {
-	long si, k, simin, simax, siminlast, simaxlast;
-	double Mv2ave, Mave;
-	
+	long k;
+	mpi_halo_t *h;
+
 //	N_LIMIT = mpiEnd-mpiBegin+1; //Its an input now.
 	*sig_n = N_LIMIT;
 
-	//MPI: Structure for ghost particles
-	struct ghost_pts {
-		double* prev;
-		double* next;
-	};
-
-	struct ghost_pts ghost_pts_vr;
-	struct ghost_pts ghost_pts_vt;
-
-	//MPI: Needs p ghost particles on either side, so allocating memory
-	ghost_pts_vr.prev = (double *) malloc(p * sizeof(double));
-	ghost_pts_vr.next = (double *) malloc(p * sizeof(double));
-	ghost_pts_vt.prev = (double *) malloc(p * sizeof(double));
-	ghost_pts_vt.next = (double *) malloc(p * sizeof(double));
-	//MPI: Buffer for communication
-	double* buf_v = (double *) malloc(2 * p * sizeof(double));
+	//MPI: Needs p ghost particles on either side; AVEKERNEL and BH_AVEKERNEL each keep their own halo
+	h = &sigma_halo[p == AVEKERNEL ? 0 : 1];
+	mpiHaloInit(h, 2 * p, MPI_COMM_WORLD);
 
-	MPI_Status stat;
+	//MPI: The 0 to p-1 elements of the buffers hold vr values, and p to 2p-1 hold the vt values.
+	for(k=0; k<p; k++)
+	{
+		h->send_prev[k] = star[1 + k].vr;
+		h->send_prev[p + k] = star[1 + k].vt;
+		h->send_next[k] = star[N_LIMIT - p + k + 1].vr;
+		h->send_next[p + k] = star[N_LIMIT - p + k + 1].vt;
+	}
 
-	/* MPI: Communicating ghost particles */
 	double tmpTimeStart = timeStartSimple();
+	mpiHaloStart(h);
+	timeEndSimple(tmpTimeStart, &t_comm);
 
-	//MPI: The 0 to p-1 elements of the buffer holds vr values, and p to 2p-1 holds the vt values.
-	for(k=0; k<2*p; k++)
-	{
-		if( k < p )
-			buf_v[k] = star[1 + k].vr;
-		else
-			buf_v[k] = star[1 + k - p].vt;
-	}
+	//MPI: Windows of stars p+1..N_LIMIT-p+1 lie within the local stars
+	sigma_sweep(p + 1, N_LIMIT - p + 1, p, N_LIMIT, h, sig_r_or_mave, sig_sigma, r_0_mave_1);
 
-	//OPT: Replace with MPI_Sendrecv. Does not optimize, but just code becomes compact.
-	//MPI: Send to previous processor
-	MPI_Send(buf_v, 2 * p, MPI_DOUBLE, ( myid + procs - 1 ) % procs, 0, MPI_COMM_WORLD);
-	MPI_Recv(buf_v, 2 * p, MPI_DOUBLE, ( myid + 1) % procs, 0, MPI_COMM_WORLD, &stat);
+	tmpTimeStart = timeStartSimple();
+	mpiHaloWait(h);
+	timeEndSimple(tmpTimeStart, &t_comm);
 
-	//MPI: Copying the received ghost particles to the allocated structure
-	for(k=0; k<2*p; k++)
-	{
-		if(myid != procs-1)
-		{
-			if( k < p )
-				ghost_pts_vr.next[k] = buf_v[k];
-			else
-				ghost_pts_vt.next[k-p] = buf_v[k];
-		}
-	}
+	sigma_sweep(1, MIN(p, N_LIMIT), p, N_LIMIT, h, sig_r_or_mave, sig_sigma, r_0_mave_1);
+	sigma_sweep(MAX(p + 1, N_LIMIT - p + 2), N_LIMIT, p, N_LIMIT, h, sig_r_or_mave, sig_sigma, r_0_mave_1);
+}
 
-	/*****************/
+/**
+* @brief marks the local environment cache as stale; called at the start of every timestep
+*/
+void local_env_invalidate(void)
+{
+	local_env.valid = 0;
+}
 
-	//MPI: Forward communication, similar to above
-	for(k=0; k<2*p; k++)
-	{
-		if( k < p )
-			buf_v[k] = star[N_LIMIT - p + k + 1].vr;
-		else
-			buf_v[k] = star[N_LIMIT - p + k + 1 - p].vt;
-	}
+/**
+* @brief Fills the local environment cache (LOCAL_ENV_CACHE) for the current timestep, unless it is already valid. Uses the same windows as calc_sigma_r(), and needs a single persistent nonblocking exchange of v^2 of the first and last few local stars with the neighbouring processors, overlapped with the density computation. The BH_AVEKERNEL kernel is only computed when THREEBODYBINARIES is on.
+*/
+void local_env_calculate(void)
+{
+	long n, P, si, k, lo, hi, simin, simax, g_si;
+	int nk, c;
+	double Mv2, M, M2, tmp, *v2;
 
-	MPI_Send(buf_v, 2 * p, MPI_DOUBLE, ( myid + 1 ) % procs, 0, MPI_COMM_WORLD);
-	MPI_Recv(buf_v, 2 * p, MPI_DOUBLE, ( myid + procs - 1) % procs, 0, MPI_COMM_WORLD, &stat);
+	if (local_env.valid) return;
 
-	for(k=0; k<2*p; k++)
-	{
-		if( myid != 0 )
-		{
-			if( k < p )
-				ghost_pts_vr.prev[k] = buf_v[k];
-			else
-				ghost_pts_vt.prev[k-p] = buf_v[k];
+	n = mpiEnd-mpiBegin+1;
+	nk = THREEBODYBINARIES ? LENV_NKERNEL : 1;
+	local_env.p[LENV_AVE] = AVEKERNEL;
+	local_env.p[LENV_BH] = BH_AVEKERNEL;
+	P = local_env.p[LENV_AVE];
+	for (c=1; c<nk; c++)
+		P = MAX(P, local_env.p[c]);
+
+	if (local_env.size < n+1) {
+		local_env.size = n+1;
+		for (c=0; c<LENV_NKERNEL; c++) {
+			local_env.mave[c] = (double *) realloc(local_env.mave[c], local_env.size * sizeof(double));
+			local_env.m2ave[c] = (double *) realloc(local_env.m2ave[c], local_env.size * sizeof(double));
+			local_env.mv2ave[c] = (double *) realloc(local_env.mv2ave[c], local_env.size * sizeof(double));
+			local_env.sigma[c] = (double *) realloc(local_env.sigma[c], local_env.size * sizeof(double));
+			local_env.n_local[c] = (double *) realloc(local_env.n_local[c], local_env.size * sizeof(double));
 		}
 	}
+	local_env.n = n;
 
-	free(buf_v);
+	/* v^2 for local indices 1-P..n+P; the P entries on either side are the ghost stars */
+	v2 = (double *) malloc((n + 2*P) * sizeof(double)) + P - 1;
+	mpiHaloInit(&local_env_halo, P, MPI_COMM_WORLD);
+	for (k=0; k<P; k++) {
+		local_env_halo.send_prev[k] = sqr(star[1 + k].vr) + sqr(star[1 + k].vt);
+		local_env_halo.send_next[k] = sqr(star[n - P + 1 + k].vr) + sqr(star[n - P + 1 + k].vt);
+	}
+
+	double tmpTimeStart = timeStartSimple();
+	mpiHaloStart(&local_env_halo);
 	timeEndSimple(tmpTimeStart, &t_comm);
-	/* End of communication */
 
-	siminlast = 1;//set to min index
-	if (myid!=0)
-		simaxlast = - p;
-	else
-		simaxlast = 0;
+	/* work that doesn't need the ghost stars */
+	for (si=1; si<=n; si++) {
+		v2[si] = sqr(star[si].vr) + sqr(star[si].vt);
+		for (c=0; c<nk; c++)
+			local_env.n_local[c][si] = calc_n_local(get_global_idx(si), local_env.p[c], clus.N_MAX);
+	}
 
-	Mv2ave = 0.0;
-	Mave = 0.0;
-	for (si=1; si<=N_LIMIT; si++) {
+	tmpTimeStart = timeStartSimple();
+	mpiHaloWait(&local_env_halo);
+	timeEndSimple(tmpTimeStart, &t_comm);
+	for (k=0; k<P; k++) {
+		v2[1 - P + k] = local_env_halo.recv_prev[k];
+		v2[n + 1 + k] = local_env_halo.recv_next[k];
+	}
 
-		//Also find the global index to figure out special cases
-		int g_si = get_global_idx(si);
-		simin = si - p;
-		int g_simin = g_si - p;
-		simax = simin + (2 * p - 1);
-		int g_simax = g_simin + (2 * p - 1); 
+	for (c=0; c<nk; c++) {
+		long p = local_env.p[c];
 
-		if (g_simin < 1) {
-			//Special case for the root node
-			simin = 1;
+		Mv2 = M = M2 = 0.0;
+		lo = hi = 0;
+		for (si=1; si<=n; si++) {
+			g_si = get_global_idx(si);
+			simin = si - p;
 			simax = simin + (2 * p - 1);
-		} else if (g_simax > clus.N_MAX) {
-			//Special case for the last node
-			simax = N_LIMIT;
-			simin = simax - (2 * p - 1);
-		}
-
-		double vr=0.0, vt=0.0;
-		// do sliding sum
-		for (k=siminlast; k<simin; k++) {
-			if (k < 1) {
-				vr = ghost_pts_vr.prev[k+p-1];
-				vt = ghost_pts_vt.prev[k+p-1];
-			} else {
-				vr = star[k].vr;
-				vt = star[k].vt;
+			if (g_si - p < 1) {
+				//Special case for the root node
+				simin = 1;
+				simax = simin + (2 * p - 1);
+			} else if (g_si + p - 1 > clus.N_MAX) {
+				//Special case for the last node
+				simax = n;
+				simin = simax - (2 * p - 1);
+			}
+			if (si == 1) {
+				lo = simin;
+				hi = simin - 1;
 			}
 
-			//MPI: Using a direct expression instead of get_global_idx() since it was changed to return the global index for stars outside local subset.
-			int g_k = Start[myid] + k - 1; //get_global_idx(k);
-			/*MPI: Using the global mass array*/
-			Mv2ave -= star_m[g_k] * madhoc * (sqr(vr) + sqr(vt));
-			Mave -= star_m[g_k] * madhoc;
-		}
-
-		for (k=simaxlast+1; k<=simax; k++) {
-			int g_k = Start[myid] + k - 1; //get_global_idx(k);
-
-			if (k > N_LIMIT) {
-				vr = ghost_pts_vr.next[k-N_LIMIT-1];
-				vt = ghost_pts_vt.next[k-N_LIMIT-1];
-			} else if (k < 1) {
-				vr = ghost_pts_vr.prev[k+p-1];
-				vt = ghost_pts_vt.prev[k+p-1];
-			} else {
-				vr = star[k].vr;
-				vt = star[k].vt;
+			// do sliding sum; the global mass array also covers the ghost stars
+			for (k=lo; k<simin; k++) {
+				tmp = star_m[Start[myid] + k - 1] * madhoc;
+				Mv2 -= tmp * v2[k];
+				M -= tmp;
+				M2 -= sqr(tmp);
 			}
+			for (k=hi+1; k<=simax; k++) {
+				tmp = star_m[Start[myid] + k - 1] * madhoc;
+				Mv2 += tmp * v2[k];
+				M += tmp;
+				M2 += sqr(tmp);
+			}
+			lo = simin;
+			hi = simax;
 
-			/*MPI: Using the global mass array*/
-			Mv2ave += star_m[g_k] * madhoc * (sqr(vr) + sqr(vt));
-			Mave += star_m[g_k] * madhoc;
+			local_env.mave[c][si] = M / (double) (2 * p);
+			local_env.m2ave[c][si] = M2 / (double) (2 * p);
+			local_env.mv2ave[c][si] = Mv2 / (double) (2 * p);
+			/* sigma is the 3D velocity dispersion */
+			local_env.sigma[c][si] = sqrt(Mv2/M);
 		}
-		
-		/* Storing r or average mass based on input parameter */
-		if(r_0_mave_1 == 0)
-			sig_r_or_mave[si] = star_r[g_si];
-		else
-			sig_r_or_mave[si] = Mave/2./p;
-
-		/* store sigma (sigma is the 3D velocity dispersion) */
-		sig_sigma[si] = sqrt(Mv2ave/Mave);
-		
-		siminlast = simin;
-		simaxlast = simax;
 	}
-	free(ghost_pts_vr.prev);
-	free(ghost_pts_vt.prev);
-	free(ghost_pts_vr.next);
-	free(ghost_pts_vt.next);
-}
 
+	free(v2 + 1 - P);
+	local_env.valid = 1;
+}
 
 /**
 * @brief calculates sliding averages of mass^2 around given index
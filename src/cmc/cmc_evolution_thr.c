@@ -351,7 +351,7 @@ double GetTimeStep(gsl_rng *rng) {
 	DTcoll = 5.0e-3 * Tcoll;
 	Dt = MIN(Dt, DTcoll);
 
-    //MPI: Reorganizing this in order to minimize communication. If it were the way it was, the root will have to broadcast the entire central_hard struct to all nodes. This way, it only needs to broadcast the final value of Dt.
+    //MPI: Reorganizing this in order to minimize communication. If it were the way it was, the root will have to broadcast the entire central_hard struct to all nodes. This way, it only needs to broadcast the final value of Dt (and the encounter limit DTenc).
     if (DT_HARD_BINARIES) {
         if(myid==0)
         {
@@ -371,8 +371,12 @@ double GetTimeStep(gsl_rng *rng) {
                 DTbs = 5.0e-3 * Tbs;
                 Dt = MIN(Dt, DTbs);
             }
+            DTenc = MIN(DTcoll, MIN(DTbb, DTbs));
         }
-        MPI_Bcast(&Dt, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        double dts[2] = { Dt, DTenc };
+        MPI_Bcast(dts, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        Dt = dts[0];
+        DTenc = dts[1];
     }
     else
     {
@@ -389,6 +393,7 @@ double GetTimeStep(gsl_rng *rng) {
             DTbs = 5.0e-3 * Tbs;
             Dt = MIN(Dt, DTbs);
         }
+        DTenc = MIN(DTcoll, MIN(DTbb, DTbs));
     }
 
 	/* calculate DTse, for now using the SE mass loss from the previous step as an indicator
@@ -437,14 +442,232 @@ double GetTimeStep(gsl_rng *rng) {
 	return (Dt);
 }
 
+/**
+* @brief strips a single star: flags it as escaped, accumulates the escaped energies and tidal mass loss, logs it and destroys it
+*
+* @param i local index of star
+* @param phi_rtidal potential at tidal radius
+* @param phi_zero potential at zero
+*/
+static void tidally_strip_star(long i, double phi_rtidal, double phi_zero) {
+	double m, r, phi;
+	long k;
+	int g_i = get_global_idx(i);
+
+	m = star_m[g_i];
+	r = star_r[g_i];
+	phi = star_phi[g_i];
+
+	if (TIDAL_TREATMENT == 0) {
+		dprintf("tidally stripping star with r_apo > Rtidal: i=%ld id=%ld m=%g E=%g binind=%ld\n", i, star[i].id, m, star[i].E, star[i].binind);
+	} else {
+		dprintf("tidally stripping star with E > phi rtidal: i=%ld id=%ld m=%g E=%g binind=%ld\n", i, star[i].id, m, star[i].E, star[i].binind);
+	}
+	star[i].rnew = SF_INFINITY;	/* tidally stripped star */
+	star[i].vrnew = 0.0;
+	star[i].vtnew = 0.0;
+	Eescaped += star[i].E * m / clus.N_STAR;
+	Jescaped += star[i].J * m / clus.N_STAR;
+
+	if (star[i].binind == 0) {
+		Eintescaped += star[i].Eint;
+	} else {
+		Ebescaped += -(binary[star[i].binind].m1/clus.N_STAR) * (binary[star[i].binind].m2/clus.N_STAR) / 
+			(2.0 * binary[star[i].binind].a);
+		Eintescaped += binary[star[i].binind].Eint1 + binary[star[i].binind].Eint2;
+	}
+
+	DTidalMassLoss += m / clus.N_STAR;
+	Etidal += star[i].E * m / clus.N_STAR;
+
+	/* logging */
+	parafprintf(escfile,
+			"%ld %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %ld ",
+			tcount, TotalTime, m * (units.m / clus.N_STAR) / MSUN,
+			r, star[i].vr, star[i].vt, star[i].r_peri,
+			star[i].r_apo, Rtidal, phi_rtidal, phi_zero, star[i].E, star[i].J, star[i].id);
+
+	k = star[i].binind;
+	if (k) {
+		parafprintf(escfile, "1 %.8g %.8g %ld %ld %.8g %.8g ", 
+				binary[k].m1 * (units.m / clus.N_STAR) / MSUN, 
+				binary[k].m2 * (units.m / clus.N_STAR) / MSUN, 
+				binary[k].id1, binary[k].id2,
+				binary[k].a * units.l / AU, binary[k].e);
+	} else {
+		parafprintf(escfile, "0 0 0 0 0 0 0 ");	
+	}
+
+	if (k == 0) {
+		//Sourav: index mistakes; make sure the fix is correct
+		parafprintf(escfile, "%d na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na %g na na %g %g %g",
+				star[i].se_k, star[i].se_bhspin, star[i].se_ospin, star[i].se_scm_B, star[i].se_scm_formation);
+	} else {
+		parafprintf(escfile, "na %d %d %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g na %g %g na na na",
+				binary[k].bse_kw[0], binary[k].bse_kw[1], binary[k].bse_radius[0], binary[k].bse_radius[1], binary[k].bse_tb, binary[k].bse_lum[0], binary[k].bse_lum[1], binary[k].bse_massc[0], binary[k].bse_massc[1], binary[k].bse_radc[0], binary[k].bse_radc[1], binary[k].bse_menv[0], binary[k].bse_menv[1], binary[k].bse_renv[0], binary[k].bse_renv[1], binary[k].bse_tms[0], binary[k].bse_tms[1], binary[k].bse_bcm_dmdt[0], binary[k].bse_bcm_dmdt[1], binary[k].bse_bcm_radrol[0], binary[k].bse_bcm_radrol[1], binary[k].bse_ospin[0], binary[k].bse_ospin[1], binary[k].bse_bcm_B[0], binary[k].bse_bcm_B[1], binary[k].bse_bcm_formation[0], binary[k].bse_bcm_formation[1], binary[k].bse_bacc[0], binary[k].bse_bacc[1], binary[k].bse_tacc[0], binary[k].bse_tacc[1], binary[k].bse_mass0[0], binary[k].bse_mass0[1], binary[k].bse_epoch[0], binary[k].bse_epoch[1], binary[k].bse_bhspin[0], binary[k].bse_bhspin[1]);
+	}
+	parafprintf (escfile, "\n");
+
+	if (TIDAL_TREATMENT == 0) {
+		// Meagan - check for, and count, escaping BHs
+		//Sourav: make sure this is correct
+		count_esc_bhs(i);
+
+		dprintf ("before SE: id=%ld k=%ld kw=%d m=%g mt=%g R=%g L=%g mc=%g rc=%g menv=%g renv=%g ospin=%g epoch=%g tms=%g tphys=%g phi=%g r=%g\n",
+				star[i].id,i,star[i].se_k,star[i].se_mass,star[i].se_mt,star[i].se_radius,star[i].se_lum,star[i].se_mc,star[i].se_rc,
+				star[i].se_menv,star[i].se_renv,star[i].se_ospin,star[i].se_epoch,star[i].se_tms,star[i].se_tphys, phi, r);
+	}
+
+	/* perhaps this will fix the problem wherein stars are ejected (and counted)
+	   multiple times */
+	destroy_obj(i);
+}
+
+/**
+* @brief stripping criterion for a given amount of mass stripped so far in this timestep: stars whose key (r_apo for TIDAL_TREATMENT==0, E for TIDAL_TREATMENT==1) exceeds the returned value are stripped
+*
+* @param dm mass stripped so far in this timestep (TidalMassLoss - OldTidalMassLoss)
+* @param gierszalpha Giersz alpha factor (only used for TIDAL_TREATMENT==1)
+* @param rt if not NULL, the corresponding tidal radius is returned here
+*
+* @return threshold on r_apo or E
+*/
+static double tidal_threshold(double dm, double gierszalpha, double *rt) {
+	double r;
+
+	r = orbit_r * pow(Mtotal - dm, 1.0/3.0);
+	if (rt != NULL) *rt = r;
+	if (TIDAL_TREATMENT == 0) return r;
+	return gierszalpha * potential(r);
+}
+
+/* the quantity compared against tidal_threshold() */
+#define TIDAL_KEY(i) (TIDAL_TREATMENT == 0 ? star[(i)].r_apo : star[(i)].E)
+
+static int tidal_bucket(double x, double tlo, double thi, double w, int nb) {
+	long b;
+
+	if (!(w > 0.0) || x > thi) return nb;
+	b = (long) ((x - tlo) / w);
+	return (int) MAX(0, MIN(b, nb-1));
+}
+
+static int tidal_pair_cmp(const void *a, const void *b) {
+	double xa = ((const double *) a)[0], xb = ((const double *) b)[0];
+	return (xa < xb) - (xa > xb);
+}
+
+/**
+* @brief finds the self-consistent tidal mass loss without iterating over the stars. The candidates are binned once by their key between the thresholds for stripping everything and for stripping nothing new; walking down from the highest bin, whole bins are stripped as long as their lowest key lies above the current threshold, and the one bin the threshold falls into is gathered and scanned star by star. The result is the same fixed point the iteration in tidally_strip_stars() converges to, since the threshold only decreases as mass is stripped (for TIDAL_TREATMENT==1 only if gierszalpha > 0, which the caller checks).
+*
+* @param dm0 mass already stripped in this timestep
+* @param gierszalpha Giersz alpha factor
+*
+* @return total mass stripped in this timestep, dm0 included
+*/
+static double tidal_strip_solve(double dm0, double gierszalpha) {
+	long i, n;
+	int b, p, nb, nlocal, stop, *cnt, *displs;
+	double tlo, thi, w, t, x, dm, *hist, *ext, *sbuf, *rbuf;
+
+	nb = TIDAL_STRIP_BUCKETS;
+	tlo = tidal_threshold(Mtotal, gierszalpha, NULL);
+	thi = tidal_threshold(dm0, gierszalpha, NULL);
+	w = (thi - tlo) / nb;
+
+	/* bin masses; ext holds -min and max of the keys in each bin */
+	hist = (double *) calloc(nb+1, sizeof(double));
+	ext = (double *) malloc(2*(nb+1) * sizeof(double));
+	for (b=0; b<=nb; b++) {
+		ext[2*b] = -GSL_POSINF;
+		ext[2*b+1] = -GSL_POSINF;
+	}
+	for (i=1; i<=clus.N_MAX_NEW; i++) {
+		if (star[i].rnew >= 1000000) continue;
+		x = TIDAL_KEY(i);
+		b = tidal_bucket(x, tlo, thi, w, nb);
+		hist[b] += star_m[get_global_idx(i)] / clus.N_STAR;
+		ext[2*b] = MAX(ext[2*b], -x);
+		ext[2*b+1] = MAX(ext[2*b+1], x);
+	}
+
+	double tmpTimeStart = timeStartSimple();
+	MPI_Allreduce(MPI_IN_PLACE, hist, nb+1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	MPI_Allreduce(MPI_IN_PLACE, ext, 2*(nb+1), MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	timeEndSimple(tmpTimeStart, &t_comm);
+
+	cnt = (int *) malloc(procs * sizeof(int));
+	displs = (int *) malloc(procs * sizeof(int));
+	dm = dm0;
+	t = thi;
+	stop = 0;
+	for (b=nb; b>=0 && !stop; b--) {
+		/* empty bin */
+		if (ext[2*b+1] == -GSL_POSINF) continue;
+		/* no star in this bin (nor below) is above the threshold */
+		if (ext[2*b+1] <= t) break;
+		/* every star in this bin is above the threshold, which only decreases */
+		if (-ext[2*b] > t) {
+			dm += hist[b];
+			t = tidal_threshold(dm, gierszalpha, NULL);
+			continue;
+		}
+
+		/* the threshold falls inside this bin: gather its (key, mass) pairs and scan them in decreasing key */
+		nlocal = 0;
+		for (i=1; i<=clus.N_MAX_NEW; i++)
+			if (star[i].rnew < 1000000 && tidal_bucket(TIDAL_KEY(i), tlo, thi, w, nb) == b)
+				nlocal++;
+		sbuf = (double *) malloc(MAX(2*nlocal, 1) * sizeof(double));
+		nlocal = 0;
+		for (i=1; i<=clus.N_MAX_NEW; i++) {
+			if (star[i].rnew >= 1000000) continue;
+			x = TIDAL_KEY(i);
+			if (tidal_bucket(x, tlo, thi, w, nb) != b) continue;
+			sbuf[2*nlocal] = x;
+			sbuf[2*nlocal+1] = star_m[get_global_idx(i)] / clus.N_STAR;
+			nlocal++;
+		}
+		cnt[myid] = 2*nlocal;
+
+		tmpTimeStart = timeStartSimple();
+		MPI_Allgather(MPI_IN_PLACE, 1, MPI_INT, cnt, 1, MPI_INT, MPI_COMM_WORLD);
+		n = 0;
+		for (p=0; p<procs; p++) {
+			displs[p] = n;
+			n += cnt[p];
+		}
+		rbuf = (double *) malloc(MAX(n, 1) * sizeof(double));
+		MPI_Allgatherv(sbuf, 2*nlocal, MPI_DOUBLE, rbuf, cnt, displs, MPI_DOUBLE, MPI_COMM_WORLD);
+		timeEndSimple(tmpTimeStart, &t_comm);
+
+		n /= 2;
+		qsort(rbuf, n, 2*sizeof(double), tidal_pair_cmp);
+		for (i=0; i<n; i++) {
+			if (rbuf[2*i] <= t) {
+				stop = 1;
+				break;
+			}
+			dm += rbuf[2*i+1];
+			t = tidal_threshold(dm, gierszalpha, NULL);
+		}
+		free(sbuf);
+		free(rbuf);
+	}
+
+	free(cnt);
+	free(displs);
+	free(hist);
+	free(ext);
+	return dm;
+}
+
 /**
 * @brief removes tidally-stripped stars
 */
 void tidally_strip_stars(void) {
-	double phi_rtidal, phi_zero, gierszalpha;
-	double m, r, phi;
-	long i, j, k;
-	k = 0;
+	double phi_rtidal, phi_zero, gierszalpha, threshold, dm0, dm;
+	long i, j;
 	j = 0;
 	Etidal = 0.0;
 
@@ -454,175 +677,66 @@ void tidally_strip_stars(void) {
             j, OldTidalMassLoss, DTidalMassLoss);
     pararootfprintf(logfile, "tidally_strip_stars(): iteration %ld: OldTidalMassLoss=%.6g DTidalMassLoss=%.6g\n",
             j, OldTidalMassLoss, DTidalMassLoss);
-	
-	/* Iterate the removal of tidally stripped stars 
-	 * by reducing Rtidal */
-	do {
-		Rtidal = orbit_r * pow(Mtotal 
-			- (TidalMassLoss - OldTidalMassLoss), 1.0/3.0);
-		phi_rtidal = potential(Rtidal);
-		phi_zero = potential(0.0);
-		DTidalMassLoss = 0.0;
-
-		for (i = 1; i <= clus.N_MAX_NEW; i++) 
-		{
-
-			int g_i = get_global_idx(i);
-			m = star_m[g_i];
-			r = star_r[g_i];
-			phi = star_phi[g_i];
-
-
-			if (TIDAL_TREATMENT == 0){
-				/*radial cut off criteria*/
-
-				if (star[i].r_apo > Rtidal && star[i].rnew < 1000000) { 
-					dprintf("tidally stripping star with r_apo > Rtidal: i=%ld id=%ld m=%g E=%g binind=%ld\n", i, star[i].id, m, star[i].E, star[i].binind);
-					star[i].rnew = SF_INFINITY;	/* tidally stripped star */
-					star[i].vrnew = 0.0;
-					star[i].vtnew = 0.0;
-					Eescaped += star[i].E * m / clus.N_STAR;
-					Jescaped += star[i].J * m / clus.N_STAR;
-
-					if (star[i].binind == 0) {
-						Eintescaped += star[i].Eint;
-					} else {
-						Ebescaped += -(binary[star[i].binind].m1/clus.N_STAR) * (binary[star[i].binind].m2/clus.N_STAR) / 
-							(2.0 * binary[star[i].binind].a);
-						Eintescaped += binary[star[i].binind].Eint1 + binary[star[i].binind].Eint2;
-					}
-
-					DTidalMassLoss += m / clus.N_STAR;
-					Etidal += star[i].E * m / clus.N_STAR;
-
-					/* logging */
-					parafprintf(escfile,
-							"%ld %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %ld ",
-							tcount, TotalTime, m * (units.m / clus.N_STAR) / MSUN,
-							r, star[i].vr, star[i].vt, star[i].r_peri,
-							star[i].r_apo, Rtidal, phi_rtidal, phi_zero, star[i].E, star[i].J, star[i].id);
-
-					if (star[i].binind) {
-						k = star[i].binind;
-						parafprintf(escfile, "1 %.8g %.8g %ld %ld %.8g %.8g ", 
-								binary[k].m1 * (units.m / clus.N_STAR) / MSUN, 
-								binary[k].m2 * (units.m / clus.N_STAR) / MSUN, 
-								binary[k].id1, binary[k].id2,
-								binary[k].a * units.l / AU, binary[k].e);
-					} else {
-						parafprintf(escfile, "0 0 0 0 0 0 0 ");	
-					}
-
-					if (star[i].binind == 0) {
-                        //parafprintf(escfile, "%d na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na %g na na %g %g",
-                                //star[i].se_k, star[i].se_bhspin, star[i].se_ospin, star[i].se_scm_B);
-
-                        //Sourav: index mistake??
-                        //parafprintf(escfile, "%d na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na %g na na",
-                        //        star[j].se_k, star[j].se_bhspin);
-                        parafprintf(escfile, "%d na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na %g na na %g %g %g",
-                                star[i].se_k, star[i].se_bhspin, star[i].se_ospin, star[i].se_scm_B, star[i].se_scm_formation);
-					} else {
-                        parafprintf(escfile, "na %d %d %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g na %g %g na na na",
-                                binary[k].bse_kw[0], binary[k].bse_kw[1], binary[k].bse_radius[0], binary[k].bse_radius[1], binary[k].bse_tb, binary[k].bse_lum[0], binary[k].bse_lum[1], binary[k].bse_massc[0], binary[k].bse_massc[1], binary[k].bse_radc[0], binary[k].bse_radc[1], binary[k].bse_menv[0], binary[k].bse_menv[1], binary[k].bse_renv[0], binary[k].bse_renv[1], binary[k].bse_tms[0], binary[k].bse_tms[1], binary[k].bse_bcm_dmdt[0], binary[k].bse_bcm_dmdt[1], binary[k].bse_bcm_radrol[0], binary[k].bse_bcm_radrol[1], binary[k].bse_ospin[0], binary[k].bse_ospin[1], binary[k].bse_bcm_B[0], binary[k].bse_bcm_B[1], binary[k].bse_bcm_formation[0], binary[k].bse_bcm_formation[1], binary[k].bse_bacc[0], binary[k].bse_bacc[1], binary[k].bse_tacc[0], binary[k].bse_tacc[1], binary[k].bse_mass0[0], binary[k].bse_mass0[1], binary[k].bse_epoch[0], binary[k].bse_epoch[1], binary[k].bse_bhspin[0], binary[k].bse_bhspin[1]);
-					}
-					parafprintf (escfile, "\n");
 
-					// Meagan - check for, and count, escaping BHs
-					//Sourav: make sure this is correct
-					count_esc_bhs(i);
+	/* DEBUG: Now using Giersz prescription for tidal stripping 
+	   (Giersz, Heggie, & Hurley 2008; arXiv:0801.3709).
+	   Note that this alpha factor behaves strangely for small N (N<~10^3) */
+	gierszalpha = 1.5 - 3.0 * pow(log(GAMMA * ((double) clus.N_STAR)) / ((double) clus.N_STAR), 0.25);
+	phi_zero = potential(0.0);
 
-					/* perhaps this will fix the problem wherein stars are ejected (and counted)
-					   multiple times */
-					dprintf ("before SE: id=%ld k=%ld kw=%d m=%g mt=%g R=%g L=%g mc=%g rc=%g menv=%g renv=%g ospin=%g epoch=%g tms=%g tphys=%g phi=%g r=%g\n",
-							star[i].id,i,star[i].se_k,star[i].se_mass,star[i].se_mt,star[i].se_radius,star[i].se_lum,star[i].se_mc,star[i].se_rc,
-							star[i].se_menv,star[i].se_renv,star[i].se_ospin,star[i].se_epoch,star[i].se_tms,star[i].se_tphys, phi, r);
+	/* the single pass relies on the threshold decreasing as mass is stripped, which for TIDAL_TREATMENT==1
+	   needs gierszalpha > 0; for small N it may not be, and the iteration is used */
+	if (TIDAL_STRIP_BUCKETS > 0 && (TIDAL_TREATMENT == 0 || gierszalpha > 0.0)) {
+		/* solve for the final tidal radius first, then strip in a single pass */
+		dm0 = TidalMassLoss - OldTidalMassLoss;
+		dm = tidal_strip_solve(dm0, gierszalpha);
+		threshold = tidal_threshold(dm, gierszalpha, &Rtidal);
+		phi_rtidal = potential(Rtidal);
 
-					destroy_obj(i);
-				}
-			}
+		for (i = 1; i <= clus.N_MAX_NEW; i++)
+			if (TIDAL_KEY(i) > threshold && star[i].rnew < 1000000)
+				tidally_strip_star(i, phi_rtidal, phi_zero);
 
-			else if (TIDAL_TREATMENT == 1){
-				/* DEBUG: Now using Giersz prescription for tidal stripping 
-				   (Giersz, Heggie, & Hurley 2008; arXiv:0801.3709).
-				   Note that this alpha factor behaves strangely for small N (N<~10^3) */
-
-				gierszalpha = 1.5 - 3.0 * pow(log(GAMMA * ((double) clus.N_STAR)) / ((double) clus.N_STAR), 0.25);
-
-				if (star[i].E > gierszalpha * phi_rtidal && star[i].rnew < 1000000) {
-					dprintf("tidally stripping star with E > phi rtidal: i=%ld id=%ld m=%g E=%g binind=%ld\n", i, star[i].id, m, star[i].E, star[i].binind); 
-					star[i].rnew = SF_INFINITY;	/* tidally stripped star */
-					star[i].vrnew = 0.0;
-					star[i].vtnew = 0.0;
-					Eescaped += star[i].E * m / clus.N_STAR;
-					Jescaped += star[i].J * m / clus.N_STAR;
-
-					if (star[i].binind == 0) {
-						Eintescaped += star[i].Eint;
-					} else {
-						Ebescaped += -(binary[star[i].binind].m1/clus.N_STAR) * (binary[star[i].binind].m2/clus.N_STAR) / 
-							(2.0 * binary[star[i].binind].a);
-						Eintescaped += binary[star[i].binind].Eint1 + binary[star[i].binind].Eint2;
-					}
-
-					DTidalMassLoss += m / clus.N_STAR;
-					Etidal += star[i].E * m / clus.N_STAR;
-
-					/* logging */
-					parafprintf(escfile,
-							"%ld %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %.8g %ld ",
-							tcount, TotalTime, m * (units.m / clus.N_STAR) / MSUN,
-							r, star[i].vr, star[i].vt, star[i].r_peri,
-							star[i].r_apo, Rtidal, phi_rtidal, phi_zero, star[i].E, star[i].J, star[i].id);
-
-					if (star[i].binind) {
-						k = star[i].binind;
-						parafprintf(escfile, "1 %.8g %.8g %ld %ld %.8g %.8g ", 
-								binary[k].m1 * (units.m / clus.N_STAR) / MSUN, 
-								binary[k].m2 * (units.m / clus.N_STAR) / MSUN, 
-								binary[k].id1, binary[k].id2,
-								binary[k].a * units.l / AU, binary[k].e);
-					} else {
-						parafprintf(escfile, "0 0 0 0 0 0 0 ");	
-					}
-
-					if (star[i].binind == 0) {
-                        //parafprintf(escfile, "%d na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na %g na na %g %g",
-                               //star[i].se_k, star[i].se_bhspin, star[i].se_ospin, star[i].se_scm_B);
-
-                        //Sourav: index mistakes; make sure the fix is correct
-                        //parafprintf(escfile, "%d na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na %g na na",
-                        //        star[j].se_k, star[j].se_bhspin);
-			parafprintf(escfile, "%d na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na na %g na na %g %g %g",
-                                star[i].se_k, star[i].se_bhspin, star[i].se_ospin, star[i].se_scm_B, star[i].se_scm_formation);
-					} else {
-                        parafprintf(escfile, "na %d %d %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g na %g %g na na na",
-                                binary[k].bse_kw[0], binary[k].bse_kw[1], binary[k].bse_radius[0], binary[k].bse_radius[1], binary[k].bse_tb, binary[k].bse_lum[0], binary[k].bse_lum[1], binary[k].bse_massc[0], binary[k].bse_massc[1], binary[k].bse_radc[0], binary[k].bse_radc[1], binary[k].bse_menv[0], binary[k].bse_menv[1], binary[k].bse_renv[0], binary[k].bse_renv[1], binary[k].bse_tms[0], binary[k].bse_tms[1], binary[k].bse_bcm_dmdt[0], binary[k].bse_bcm_dmdt[1], binary[k].bse_bcm_radrol[0], binary[k].bse_bcm_radrol[1], binary[k].bse_ospin[0], binary[k].bse_ospin[1], binary[k].bse_bcm_B[0], binary[k].bse_bcm_B[1], binary[k].bse_bcm_formation[0], binary[k].bse_bcm_formation[1], binary[k].bse_bacc[0], binary[k].bse_bacc[1], binary[k].bse_tacc[0], binary[k].bse_tacc[1], binary[k].bse_mass0[0], binary[k].bse_mass0[1], binary[k].bse_epoch[0], binary[k].bse_epoch[1], binary[k].bse_bhspin[0], binary[k].bse_bhspin[1]);
-					}
-					parafprintf (escfile, "\n");
+		/* the solver already summed the stripped mass over all nodes */
+		j++;
+		DTidalMassLoss = dm - dm0;
+		TidalMassLoss += DTidalMassLoss;
 
-					/* perhaps this will fix the problem wherein stars are ejected (and counted)
-					   multiple times */
-					destroy_obj(i);
-				}
+		rootgprintf("tidally_strip_stars(): iteration %ld: TidalMassLoss=%.6g DTidalMassLoss=%.6g\n",
+				j, TidalMassLoss, DTidalMassLoss);
+		pararootfprintf(logfile, "tidally_strip_stars(): iteration %ld: TidalMassLoss=%.6g DTidalMassLoss=%.6g\n",
+				j, TidalMassLoss, DTidalMassLoss);
+	} else {
+		/* Iterate the removal of tidally stripped stars 
+		 * by reducing Rtidal */
+		do {
+			threshold = tidal_threshold(TidalMassLoss - OldTidalMassLoss, gierszalpha, &Rtidal);
+			phi_rtidal = potential(Rtidal);
+			DTidalMassLoss = 0.0;
+
+			for (i = 1; i <= clus.N_MAX_NEW; i++) 
+			{
+				/* radial cut off criteria for TIDAL_TREATMENT==0, energy criterion for TIDAL_TREATMENT==1 */
+				if (TIDAL_KEY(i) > threshold && star[i].rnew < 1000000)
+					tidally_strip_star(i, phi_rtidal, phi_zero);
 			}
-		}
 
-		j++;
+			j++;
 
-		//MPI: Here, we have to sum up the value across all processors for the condition in the while loop.
-		double tmpTimeStart = timeStartSimple();
-		MPI_Allreduce(MPI_IN_PLACE, &DTidalMassLoss, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-		timeEndSimple(tmpTimeStart, &t_comm);
-		TidalMassLoss += DTidalMassLoss;
+			//MPI: Here, we have to sum up the value across all processors for the condition in the while loop.
+			double tmpTimeStart = timeStartSimple();
+			MPI_Allreduce(MPI_IN_PLACE, &DTidalMassLoss, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+			timeEndSimple(tmpTimeStart, &t_comm);
+			TidalMassLoss += DTidalMassLoss;
 
-        rootgprintf("tidally_strip_stars(): iteration %ld: TidalMassLoss=%.6g DTidalMassLoss=%.6g\n",
-                j, TidalMassLoss, DTidalMassLoss);
-        pararootfprintf(logfile, "tidally_strip_stars(): iteration %ld: TidalMassLoss=%.6g DTidalMassLoss=%.6g\n",
-                j, TidalMassLoss, DTidalMassLoss);
+			rootgprintf("tidally_strip_stars(): iteration %ld: TidalMassLoss=%.6g DTidalMassLoss=%.6g\n",
+					j, TidalMassLoss, DTidalMassLoss);
+			pararootfprintf(logfile, "tidally_strip_stars(): iteration %ld: TidalMassLoss=%.6g DTidalMassLoss=%.6g\n",
+					j, TidalMassLoss, DTidalMassLoss);
 
 
-	} while (DTidalMassLoss > 0);
+		} while (DTidalMassLoss > 0);
+	}
 
 	//MPI: Packing into array to optimize communication.
 	double buf_reduce[5];
@@ -74,7 +74,8 @@ void load_fits_file_data(void)
 	//MPI: Just to load the 0th element (never used) with whatever is in the cfd struct.
 	load_binary_data(0, 0);
 
-	//MPI: Copying only the data each process needs.
+	//MPI: Copying only the data each process needs; the arrays are grown if this process got more than its share.
+	star_array_reserve(End[myid] - Start[myid] + 3);
 	for (i=0; i<=End[myid] - Start[myid]+1; i++) {
 		//MPI: Getting global index to read only stars that belong to this processor.
 		if(i==0) g_i = 0;
@@ -91,6 +92,7 @@ void load_fits_file_data(void)
 		//Copying binary info
       if(cfd.obj_binind[g_i])
       {
+         binary_array_reserve(b_i + 1);
          load_binary_data(b_i, cfd.obj_binind[g_i]);
          star[i].binind = b_i;
          b_i++;
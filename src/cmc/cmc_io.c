@@ -15,6 +15,7 @@
 #include <gsl/gsl_rng.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include "cmc.h"
 #include "cmc_vars.h"
 #include "hdf5.h"
@@ -1618,6 +1619,83 @@ if(myid==0) {
 				PRINT_PARSED(PARAMDOC_TIMER);
 				sscanf(values, "%d", &TIMER);
 				parsed.TIMER = 1;
+			} else if (strcmp(parameter_name, "SE_SKIP_REMNANTS")== 0) {
+				PRINT_PARSED(PARAMDOC_SE_SKIP_REMNANTS);
+				sscanf(values, "%d", &SE_SKIP_REMNANTS);
+				parsed.SE_SKIP_REMNANTS = 1;
+			} else if (strcmp(parameter_name, "SE_SKIP_INTERVAL")== 0) {
+				PRINT_PARSED(PARAMDOC_SE_SKIP_INTERVAL);
+				sscanf(values, "%lf", &SE_SKIP_INTERVAL);
+				parsed.SE_SKIP_INTERVAL = 1;
+			} else if (strcmp(parameter_name, "SE_BATCH_SIZE")== 0) {
+				PRINT_PARSED(PARAMDOC_SE_BATCH_SIZE);
+				sscanf(values, "%d", &SE_BATCH_SIZE);
+				parsed.SE_BATCH_SIZE = 1;
+			} else if (strcmp(parameter_name, "SE_TABLE")== 0) {
+				PRINT_PARSED(PARAMDOC_SE_TABLE);
+				sscanf(values, "%d", &SE_TABLE);
+				parsed.SE_TABLE = 1;
+			} else if (strcmp(parameter_name, "SE_TABLE_FILE")== 0) {
+				PRINT_PARSED(PARAMDOC_SE_TABLE_FILE);
+				if (strncmp(values, "NULL", 4) == 0) {
+					SE_TABLE_FILE = NULL;
+				} else{
+					SE_TABLE_FILE = (char *) malloc(sizeof(char)*500);
+					strncpy(SE_TABLE_FILE, values, 500);
+				}
+				parsed.SE_TABLE_FILE = 1;
+			} else if (strcmp(parameter_name, "SE_PTS1_WINDOW")== 0) {
+				PRINT_PARSED(PARAMDOC_SE_PTS1_WINDOW);
+				sscanf(values, "%lf", &SE_PTS1_WINDOW);
+				parsed.SE_PTS1_WINDOW = 1;
+			} else if (strcmp(parameter_name, "FUSED_DIAGNOSTICS")== 0) {
+				PRINT_PARSED(PARAMDOC_FUSED_DIAGNOSTICS);
+				sscanf(values, "%d", &FUSED_DIAGNOSTICS);
+				parsed.FUSED_DIAGNOSTICS = 1;
+			} else if (strcmp(parameter_name, "CENTRAL_DISTRIBUTED")== 0) {
+				PRINT_PARSED(PARAMDOC_CENTRAL_DISTRIBUTED);
+				sscanf(values, "%d", &CENTRAL_DISTRIBUTED);
+				parsed.CENTRAL_DISTRIBUTED = 1;
+			} else if (strcmp(parameter_name, "REPRODUCIBLE_SUMS")== 0) {
+				PRINT_PARSED(PARAMDOC_REPRODUCIBLE_SUMS);
+				sscanf(values, "%d", &REPRODUCIBLE_SUMS);
+				parsed.REPRODUCIBLE_SUMS = 1;
+			} else if (strcmp(parameter_name, "TIDAL_STRIP_BUCKETS")== 0) {
+				PRINT_PARSED(PARAMDOC_TIDAL_STRIP_BUCKETS);
+				sscanf(values, "%d", &TIDAL_STRIP_BUCKETS);
+				parsed.TIDAL_STRIP_BUCKETS = 1;
+			} else if (strcmp(parameter_name, "LOCAL_ENV_CACHE")== 0) {
+				PRINT_PARSED(PARAMDOC_LOCAL_ENV_CACHE);
+				sscanf(values, "%d", &LOCAL_ENV_CACHE);
+				parsed.LOCAL_ENV_CACHE = 1;
+			} else if (strcmp(parameter_name, "BLOCK_TIMESTEP_LEVELS")== 0) {
+				PRINT_PARSED(PARAMDOC_BLOCK_TIMESTEP_LEVELS);
+				sscanf(values, "%d", &BLOCK_TIMESTEP_LEVELS);
+				parsed.BLOCK_TIMESTEP_LEVELS = 1;
+			} else if (strcmp(parameter_name, "RELAX_BATCH")== 0) {
+				PRINT_PARSED(PARAMDOC_RELAX_BATCH);
+				sscanf(values, "%d", &RELAX_BATCH);
+				parsed.RELAX_BATCH = 1;
+			} else if (strcmp(parameter_name, "COMPACT_CHECKPOINT")== 0) {
+				PRINT_PARSED(PARAMDOC_COMPACT_CHECKPOINT);
+				sscanf(values, "%d", &COMPACT_CHECKPOINT);
+				parsed.COMPACT_CHECKPOINT = 1;
+			} else if (strcmp(parameter_name, "GLOBAL_ARRAYS_HUGEPAGES")== 0) {
+				PRINT_PARSED(PARAMDOC_GLOBAL_ARRAYS_HUGEPAGES);
+				sscanf(values, "%d", &GLOBAL_ARRAYS_HUGEPAGES);
+				parsed.GLOBAL_ARRAYS_HUGEPAGES = 1;
+			} else if (strcmp(parameter_name, "HIER_COLLECTIVES")== 0) {
+				PRINT_PARSED(PARAMDOC_HIER_COLLECTIVES);
+				sscanf(values, "%d", &HIER_COLLECTIVES);
+				parsed.HIER_COLLECTIVES = 1;
+			} else if (strcmp(parameter_name, "POTENTIAL_PIPELINE_SEGMENTS")== 0) {
+				PRINT_PARSED(PARAMDOC_POTENTIAL_PIPELINE_SEGMENTS);
+				sscanf(values, "%d", &POTENTIAL_PIPELINE_SEGMENTS);
+				parsed.POTENTIAL_PIPELINE_SEGMENTS = 1;
+			} else if (strcmp(parameter_name, "SORT_SPLITTER_PREDICT")== 0) {
+				PRINT_PARSED(PARAMDOC_SORT_SPLITTER_PREDICT);
+				sscanf(values, "%d", &SORT_SPLITTER_PREDICT);
+				parsed.SORT_SPLITTER_PREDICT = 1;
 			} else {
 				wprintf("unknown parameter: \"%s\".\n", line);
 			}
@@ -2020,6 +2098,24 @@ if(myid==0) {
 	CHECK_PARSED(BH_RADIUS_MULTIPLYER, 5, PARAMDOC_BH_RADIUS_MULTIPLYER);
 	CHECK_PARSED(BSE_IDUM, -999, PARAMDOC_BSE_IDUM);
 	CHECK_PARSED(TIMER, 0, PARAMDOC_TIMER);
+	CHECK_PARSED(SE_SKIP_REMNANTS, 0, PARAMDOC_SE_SKIP_REMNANTS);
+	CHECK_PARSED(SE_SKIP_INTERVAL, 1000.0, PARAMDOC_SE_SKIP_INTERVAL);
+	CHECK_PARSED(SE_BATCH_SIZE, 0, PARAMDOC_SE_BATCH_SIZE);
+	CHECK_PARSED(SE_TABLE, 0, PARAMDOC_SE_TABLE);
+	CHECK_PARSED(SE_TABLE_FILE, NULL, PARAMDOC_SE_TABLE_FILE);
+	CHECK_PARSED(SE_PTS1_WINDOW, 0.0, PARAMDOC_SE_PTS1_WINDOW);
+	CHECK_PARSED(FUSED_DIAGNOSTICS, 0, PARAMDOC_FUSED_DIAGNOSTICS);
+	CHECK_PARSED(CENTRAL_DISTRIBUTED, 0, PARAMDOC_CENTRAL_DISTRIBUTED);
+	CHECK_PARSED(REPRODUCIBLE_SUMS, 0, PARAMDOC_REPRODUCIBLE_SUMS);
+	CHECK_PARSED(TIDAL_STRIP_BUCKETS, 0, PARAMDOC_TIDAL_STRIP_BUCKETS);
+	CHECK_PARSED(LOCAL_ENV_CACHE, 0, PARAMDOC_LOCAL_ENV_CACHE);
+	CHECK_PARSED(BLOCK_TIMESTEP_LEVELS, 0, PARAMDOC_BLOCK_TIMESTEP_LEVELS);
+	CHECK_PARSED(RELAX_BATCH, 0, PARAMDOC_RELAX_BATCH);
+	CHECK_PARSED(COMPACT_CHECKPOINT, 0, PARAMDOC_COMPACT_CHECKPOINT);
+	CHECK_PARSED(GLOBAL_ARRAYS_HUGEPAGES, 0, PARAMDOC_GLOBAL_ARRAYS_HUGEPAGES);
+	CHECK_PARSED(HIER_COLLECTIVES, 0, PARAMDOC_HIER_COLLECTIVES);
+	CHECK_PARSED(POTENTIAL_PIPELINE_SEGMENTS, 0, PARAMDOC_POTENTIAL_PIPELINE_SEGMENTS);
+	CHECK_PARSED(SORT_SPLITTER_PREDICT, 0, PARAMDOC_SORT_SPLITTER_PREDICT);
 #undef CHECK_PARSED
 
 	/* exit if something is not set */
@@ -2076,7 +2172,7 @@ if(myid==0)
 	N_STAR_DIM = 2 + clus.N_STAR + 2 * clus.N_BINARY;
 	/* remember we can form binaries from tidal capture */
 	N_BIN_DIM = 2 + clus.N_STAR / 2 + clus.N_BINARY;
-	/* safety factors, so we don't have to worry about memory management/garbage collection */
+	/* safety factors; the arrays grow when needed, see star_array_reserve() */
 	N_STAR_DIM = (long) floor(1.1 * ((double) N_STAR_DIM));
 	N_BIN_DIM = (long) floor(1.1 * ((double) N_BIN_DIM));
 
@@ -2091,9 +2187,9 @@ if(myid==0)
 	//MPI: Allocating only enough memory per processor.
 	N_STAR_DIM_OPT = 1 + clus.N_STAR / procs + 2 * clus.N_BINARY / procs;
 	N_BIN_DIM_OPT = clus.N_STAR / (2 * procs) + clus.N_BINARY / procs;
-	//MPI: Giving a larger safety factor for the parallel version.
-	N_STAR_DIM_OPT = (long) floor(1.5 * ((double) N_STAR_DIM_OPT));
-	N_BIN_DIM_OPT = (long) floor(1.5 * ((double) N_BIN_DIM_OPT));
+	//MPI: Safety factor for the imbalance between processors; the arrays grow when needed.
+	N_STAR_DIM_OPT = (long) floor(1.1 * ((double) N_STAR_DIM_OPT)) + 2;
+	N_BIN_DIM_OPT = (long) floor(1.1 * ((double) N_BIN_DIM_OPT)) + 2;
 	if(RESTART_TCOUNT == 0){
 		/* the main star array containing all star parameters */
 		star = (star_t *) calloc(N_STAR_DIM_OPT, sizeof(star_t));
@@ -3419,15 +3515,196 @@ void get_star_data(int argc, char *argv[], gsl_rng *rng)
 	//star[clus.N_MAX+1].E = star[clus.N_MAX+1].J = 0.0;
 }
 
+/* under GLOBAL_ARRAYS_HUGEPAGES the duplicated arrays are aligned to (and rounded up to) this size */
+#define HUGEPAGE_SIZE (2UL * 1024 * 1024)
+
+/**
+* @brief allocates one of the duplicated arrays star_r, star_m or star_phi. Under GLOBAL_ARRAYS_HUGEPAGES it is aligned to huge pages and the kernel is asked to back it with them; it is left untouched, so its pages are placed on the NUMA node of the process that first writes them.
+*
+* @param n number of elements
+*
+* @return the array
+*/
+static double *global_array_alloc(long n)
+{
+	void *p;
+	size_t size = n * sizeof(double);
+
+	if (!GLOBAL_ARRAYS_HUGEPAGES)
+		return((double *) malloc(size));
+
+	size = (size + HUGEPAGE_SIZE - 1) / HUGEPAGE_SIZE * HUGEPAGE_SIZE;
+	if (posix_memalign(&p, HUGEPAGE_SIZE, size) != 0) {
+		eprintf("cannot allocate %zu bytes aligned to huge pages!\n", size);
+		exit_cleanly(-1, __FUNCTION__);
+	}
+#ifdef MADV_HUGEPAGE
+	madvise(p, size, MADV_HUGEPAGE);
+#endif
+
+	return((double *) p);
+}
+
 /**
 * @brief Allocate global arrays based on total number of stars
 */
 void mpiInitGlobArrays()
 {
 	/*MPI: Allocating global/duplicated arrays that will be needed by all processors.*/
-	star_r = (double *) malloc(N_STAR_DIM * sizeof(double));
-	star_m = (double *) malloc(N_STAR_DIM * sizeof(double));
-	star_phi = (double *) malloc(N_STAR_DIM * sizeof(double));
+	N_STAR_DIM = MAX(N_STAR_DIM, clus.N_MAX + 2);
+	star_r = global_array_alloc(N_STAR_DIM);
+	star_m = global_array_alloc(N_STAR_DIM);
+	star_phi = global_array_alloc(N_STAR_DIM);
+}
+
+/* The local star and binary arrays and the global star_r/star_m/star_phi arrays grow by ARRAY_GROWTH
+   whenever they are full, and after a sort are shrunk to twice their live size if less than
+   1/ARRAY_SHRINK of them is in use. */
+#define ARRAY_GROWTH 1.5
+#define ARRAY_SHRINK 4
+
+/**
+* @brief resizes an array, zeroing the elements past its old size
+*
+* @param p the array
+* @param old_n old number of elements
+* @param n new number of elements
+* @param size size of one element
+*
+* @return the (possibly moved) array
+*/
+static void *resize_array(void *p, long old_n, long n, size_t size)
+{
+	p = realloc(p, n * size);
+	if (p == NULL) {
+		eprintf("cannot resize array from %ld to %ld elements!\n", old_n, n);
+		exit_cleanly(-1, __FUNCTION__);
+	}
+	if (n > old_n)
+		memset((char *) p + old_n * size, 0, (n - old_n) * size);
+
+	return(p);
+}
+
+/**
+* @brief resizes one of the duplicated arrays, keeping it aligned to huge pages under GLOBAL_ARRAYS_HUGEPAGES
+*
+* @param p the array
+* @param old_n old number of elements
+* @param n new number of elements
+*
+* @return the (possibly moved) array
+*/
+static double *global_array_resize(double *p, long old_n, long n)
+{
+	double *q;
+
+	if (!GLOBAL_ARRAYS_HUGEPAGES)
+		return((double *) resize_array(p, old_n, n, sizeof(double)));
+
+	q = global_array_alloc(n);
+	memcpy(q, p, MIN(old_n, n) * sizeof(double));
+	if (n > old_n)
+		memset(q + old_n, 0, (n - old_n) * sizeof(double));
+	free(p);
+
+	return(q);
+}
+
+/**
+* @brief makes sure the local star array, and the velocity dispersion array sized with it, hold at least n stars
+*
+* @param n number of stars, including star[0] and the sentinel after the last star
+*
+* @return 1 if the arrays were reallocated, so pointers into them are stale
+*/
+int star_array_reserve(long n)
+{
+	long dim;
+
+	if (n <= N_STAR_DIM_OPT)
+		return(0);
+
+	dim = MAX(n, (long) (ARRAY_GROWTH * N_STAR_DIM_OPT));
+	dprintf("growing star array on node %d from %ld to %ld\n", myid, N_STAR_DIM_OPT, dim);
+	star = (star_t *) resize_array(star, N_STAR_DIM_OPT, dim, sizeof(star_t));
+	sigma_array.r = (double *) resize_array(sigma_array.r, N_STAR_DIM_OPT, dim, sizeof(double));
+	sigma_array.sigma = (double *) resize_array(sigma_array.sigma, N_STAR_DIM_OPT, dim, sizeof(double));
+	N_STAR_DIM_OPT = dim;
+
+	return(1);
+}
+
+/**
+* @brief makes sure the local binary array holds at least n binaries. The bitmap of used binary slots has to be extended or reset afterwards.
+*
+* @param n number of binaries, including binary[0]
+*
+* @return 1 if the array was reallocated, so pointers into it are stale
+*/
+int binary_array_reserve(long n)
+{
+	long dim;
+
+	if (n <= N_BIN_DIM_OPT)
+		return(0);
+
+	dim = MAX(n, (long) (ARRAY_GROWTH * N_BIN_DIM_OPT));
+	dprintf("growing binary array on node %d from %ld to %ld\n", myid, N_BIN_DIM_OPT, dim);
+	binary = (binary_t *) resize_array(binary, N_BIN_DIM_OPT, dim, sizeof(binary_t));
+	N_BIN_DIM_OPT = dim;
+
+	return(1);
+}
+
+/**
+* @brief makes sure the duplicated arrays star_r, star_m and star_phi hold at least n stars
+*
+* @param n number of stars, including star 0 and the sentinel after the last star
+*/
+void global_arrays_reserve(long n)
+{
+	long dim;
+
+	if (n <= N_STAR_DIM)
+		return;
+
+	dim = MAX(n, (long) (ARRAY_GROWTH * N_STAR_DIM));
+	star_r = global_array_resize(star_r, N_STAR_DIM, dim);
+	star_m = global_array_resize(star_m, N_STAR_DIM, dim);
+	star_phi = global_array_resize(star_phi, N_STAR_DIM, dim);
+	N_STAR_DIM = dim;
+}
+
+/**
+* @brief after a sort, shrinks the local star and binary arrays and the duplicated arrays if most of them is unused. Must be called before the bitmap of used binary slots is reset.
+*/
+void arrays_shrink_to_fit(void)
+{
+	long n;
+
+	n = clus.N_MAX_NEW + 2;
+	if (ARRAY_SHRINK * n < N_STAR_DIM_OPT) {
+		star = (star_t *) resize_array(star, N_STAR_DIM_OPT, 2*n, sizeof(star_t));
+		sigma_array.r = (double *) resize_array(sigma_array.r, N_STAR_DIM_OPT, 2*n, sizeof(double));
+		sigma_array.sigma = (double *) resize_array(sigma_array.sigma, N_STAR_DIM_OPT, 2*n, sizeof(double));
+		N_STAR_DIM_OPT = 2*n;
+	}
+
+	/* the binaries were repacked into slots 1 to N_b_local */
+	n = N_b_local + 1;
+	if (ARRAY_SHRINK * n < N_BIN_DIM_OPT) {
+		binary = (binary_t *) resize_array(binary, N_BIN_DIM_OPT, 2*n, sizeof(binary_t));
+		N_BIN_DIM_OPT = 2*n;
+	}
+
+	n = clus.N_MAX + 2;
+	if (ARRAY_SHRINK * n < N_STAR_DIM) {
+		star_r = global_array_resize(star_r, N_STAR_DIM, 2*n);
+		star_m = global_array_resize(star_m, N_STAR_DIM, 2*n);
+		star_phi = global_array_resize(star_phi, N_STAR_DIM, 2*n);
+		N_STAR_DIM = 2*n;
+	}
 }
 
 void load_dynamical_friction_data()
@@ -3847,17 +4124,26 @@ void save_restart_file(){
 
 	
 	/*Save the entire star and binary arrays, including the many empty stars at
-	 * the end; easier this way, and it ensures a bit-by-bit restart (also, the
-	 * N_*_DIM_OPT are never updated, and should be the same as when the
-	 * original star and binary structures were allocated)*/
+	 * the end; easier this way, and it ensures a bit-by-bit restart. The arrays
+	 * grow during the run, so their sizes are saved in front of them*/
 	clus.N_BINARY = N_b;
 	save_global_vars(&restart_struct);
 
 	fwrite(curr_st, sizeof(struct rng_t113_state), 1, my_restart_file);
 	fwrite(&restart_struct, sizeof(restart_struct_t), 1, my_restart_file);
 	fwrite(&clus, sizeof(clus_struct_t), 1, my_restart_file);
-	fwrite(star, sizeof(star_t), N_STAR_DIM_OPT, my_restart_file);
-	fwrite(binary, sizeof(binary_t), N_BIN_DIM_OPT, my_restart_file);
+	long n_star = N_STAR_DIM_OPT, n_bin = N_BIN_DIM_OPT;
+	if (COMPACT_CHECKPOINT) {
+		/*Only the local stars (up to the sentinel after the last one) and the
+		 * binary slots up to the highest one in use; nothing past them is ever
+		 * read before it is overwritten, so the restart stays bit-by-bit*/
+		n_star = MIN(clus.N_MAX_NEW+2, N_STAR_DIM_OPT);
+		n_bin = binary_slots_live_end();
+	}
+	fwrite(&n_star, sizeof(long), 1, my_restart_file);
+	fwrite(&n_bin, sizeof(long), 1, my_restart_file);
+	fwrite(star, sizeof(star_t), n_star, my_restart_file);
+	fwrite(binary, sizeof(binary_t), n_bin, my_restart_file);
 	fwrite(snapshot_window_counters, sizeof(int), snapshot_window_count, my_restart_file);
 
 	fclose(my_restart_file);
@@ -3902,22 +4188,28 @@ void load_restart_file(){
 	}
 
 	/*These must be allocated here for the binary files to load correctly*/
-	star = (star_t *) malloc(N_STAR_DIM_OPT*sizeof(star_t));
-	binary = (binary_t *) malloc(N_BIN_DIM_OPT*sizeof(binary_t));
+	star = (star_t *) calloc(N_STAR_DIM_OPT, sizeof(star_t));
+	binary = (binary_t *) calloc(N_BIN_DIM_OPT, sizeof(binary_t));
 	curr_st = (struct rng_t113_state*) malloc(sizeof(struct rng_t113_state));
 
 	/*Set the units using the original data from the fits file*/
 	units_set();
 	
 	/*Load the entire star and binaries arrays at once.  Because this is done in
-	 * a single chunk of memory and with the same size of arrays as was
-	 * generated from the FITS file, this should load the exact local state into
-	 * each file*/
+	 * a single chunk of memory and with the arrays grown to the size they had
+	 * when saved, this should load the exact local state into each file*/
 	fread(curr_st, sizeof(struct rng_t113_state), 1, my_restart_file);
 	fread(&restart_struct, sizeof(restart_struct_t), 1, my_restart_file);
 	fread(&clus, sizeof(clus_struct_t), 1, my_restart_file);
-	fread(star, sizeof(star_t), N_STAR_DIM_OPT, my_restart_file);
-	fread(binary, sizeof(binary_t), N_BIN_DIM_OPT, my_restart_file);
+	/*The arrays may have grown during the run (or only their live parts were
+	 * saved, with the rest staying zero)*/
+	long n_star, n_bin;
+	fread(&n_star, sizeof(long), 1, my_restart_file);
+	fread(&n_bin, sizeof(long), 1, my_restart_file);
+	star_array_reserve(n_star);
+	binary_array_reserve(n_bin);
+	fread(star, sizeof(star_t), n_star, my_restart_file);
+	fread(binary, sizeof(binary_t), n_bin, my_restart_file);
 	fread(snapshot_window_counters, sizeof(int), snapshot_window_count, my_restart_file);
 
 	fclose(my_restart_file);
@@ -1,4 +1,6 @@
 /* vi: set filetype=c.doxygen: */
+#include <stdlib.h>
+#include <math.h>
 #include "cmc_mpi.h"
 #include "cmc.h"
 #include "cmc_vars.h"
@@ -205,3 +207,183 @@ void mpiReduceAndBcast( void *sendbuf, void *recvbuf, int count, MPI_Datatype da
 {
 }
 */
+
+/**
+* @brief Sets up reproducible sums (see mpiReproSum()). Pre-rounding splits every term against fixed boundaries derived from the global maximum of the terms, so the partial sums at each of the REPRO_LEVELS levels are exact and can be added up in any order, on any number of processors.
+*
+* @param maxabs local maxima of the absolute values of the terms of each sum; overwritten with the global maxima
+* @param count number of independent sums
+* @param ntot upper bound on the total number of terms of each sum across all processors
+* @param M array of count boundaries to pass to reproAdd()
+* @param step factor between the boundaries of successive levels, to pass to reproAdd()
+* @param comm MPI communicator
+*/
+void mpiReproBounds( double *maxabs, int count, long ntot, double *M, double *step, MPI_Comm comm )
+{
+	int c, e, L;
+
+	double tmpTimeStart = timeStartSimple();
+	MPI_Allreduce(MPI_IN_PLACE, maxabs, count, MPI_DOUBLE, MPI_MAX, comm);
+	timeEndSimple(tmpTimeStart, &t_comm);
+
+	/* headroom for adding up ntot terms without leaving the exact range */
+	L = (int) ceil(log2((double) ntot + 1.0)) + 1;
+	*step = ldexp(1.0, L - 53);
+	for (c=0; c<count; c++) {
+		if (maxabs[c] == 0.0) {
+			M[c] = 0.0;
+		} else {
+			frexp(maxabs[c], &e);
+			M[c] = ldexp(1.0, e + L);
+		}
+	}
+}
+
+/**
+* @brief Adds a term to the REPRO_LEVELS exact partial sums of a reproducible sum.
+*
+* @param x term, with |x| not larger than the maximum passed to mpiReproBounds()
+* @param M boundary of the sum from mpiReproBounds()
+* @param step level factor from mpiReproBounds()
+* @param part array of REPRO_LEVELS partial sums
+*/
+void reproAdd( double x, double M, double step, double *part )
+{
+	int lev;
+	double q;
+
+	for (lev=0; lev<REPRO_LEVELS; lev++) {
+		q = (M + x) - M;
+		part[lev] += q;
+		x -= q;
+		M *= step;
+	}
+}
+
+/**
+* @brief Adds up the partial sums of count reproducible sums across all processors and combines the levels, in a fixed order.
+*
+* @param part local partial sums, REPRO_LEVELS for each of the count sums
+* @param count number of independent sums
+* @param sums array of count global sums, the same on all processors
+* @param comm MPI communicator
+*/
+void mpiReproFinish( double *part, int count, double *sums, MPI_Comm comm )
+{
+	int c, lev;
+
+	double tmpTimeStart = timeStartSimple();
+	MPI_Allreduce(MPI_IN_PLACE, part, REPRO_LEVELS*count, MPI_DOUBLE, MPI_SUM, comm);
+	timeEndSimple(tmpTimeStart, &t_comm);
+
+	for (c=0; c<count; c++) {
+		sums[c] = 0.0;
+		for (lev=0; lev<REPRO_LEVELS; lev++)
+			sums[c] += part[REPRO_LEVELS*c+lev];
+	}
+}
+
+/**
+* @brief Sums terms across all processors such that the result is bitwise identical regardless of the number of processors and of how the terms are distributed among them (see mpiReproBounds()).
+*
+* @param terms local terms, nloc rows of count values each
+* @param nloc number of local rows
+* @param count number of values per row, i.e. number of independent sums
+* @param ntot upper bound on the total number of rows across all processors
+* @param sums array of count global sums, the same on all processors
+* @param comm MPI communicator
+*/
+void mpiReproSum( double *terms, long nloc, int count, long ntot, double *sums, MPI_Comm comm )
+{
+	long i;
+	int c;
+	double *maxabs, *M, *part, step;
+
+	maxabs = (double *) calloc(count, sizeof(double));
+	M = (double *) malloc(count * sizeof(double));
+	part = (double *) calloc(REPRO_LEVELS*count, sizeof(double));
+
+	for (i=0; i<nloc; i++)
+		for (c=0; c<count; c++)
+			maxabs[c] = MAX(maxabs[c], fabs(terms[i*count+c]));
+
+	mpiReproBounds(maxabs, count, ntot, M, &step, comm);
+
+	for (i=0; i<nloc; i++)
+		for (c=0; c<count; c++)
+			reproAdd(terms[i*count+c], M[c], step, &part[REPRO_LEVELS*c]);
+
+	mpiReproFinish(part, count, sums, comm);
+
+	free(maxabs);
+	free(M);
+	free(part);
+}
+
+/**
+* @brief Sets up (or resizes) a persistent halo exchange of count doubles with each of the neighbouring processors. Does nothing if h is already set up for count. A zeroed mpi_halo_t is a valid, not yet initialized halo.
+*
+* @param h halo
+* @param count number of doubles exchanged with each neighbour
+* @param comm MPI communicator
+*/
+void mpiHaloInit( mpi_halo_t *h, int count, MPI_Comm comm )
+{
+	int rank, size, prev, next;
+
+	if (h->count == count && h->send_prev != NULL) return;
+	mpiHaloFree(h);
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+	prev = (rank > 0) ? rank - 1 : MPI_PROC_NULL;
+	next = (rank < size - 1) ? rank + 1 : MPI_PROC_NULL;
+
+	h->count = count;
+	h->send_prev = (double *) calloc(4 * count, sizeof(double));
+	h->send_next = h->send_prev + count;
+	h->recv_prev = h->send_prev + 2 * count;
+	h->recv_next = h->send_prev + 3 * count;
+
+	MPI_Recv_init(h->recv_prev, count, MPI_DOUBLE, prev, 1, comm, &h->req[0]);
+	MPI_Recv_init(h->recv_next, count, MPI_DOUBLE, next, 0, comm, &h->req[1]);
+	MPI_Send_init(h->send_prev, count, MPI_DOUBLE, prev, 0, comm, &h->req[2]);
+	MPI_Send_init(h->send_next, count, MPI_DOUBLE, next, 1, comm, &h->req[3]);
+}
+
+/**
+* @brief Starts the halo exchange; the send buffers must not be touched until mpiHaloWait().
+*
+* @param h halo
+*/
+void mpiHaloStart( mpi_halo_t *h )
+{
+	MPI_Startall(4, h->req);
+}
+
+/**
+* @brief Completes the halo exchange started by mpiHaloStart().
+*
+* @param h halo
+*/
+void mpiHaloWait( mpi_halo_t *h )
+{
+	MPI_Waitall(4, h->req, MPI_STATUSES_IGNORE);
+}
+
+/**
+* @brief Releases the buffers and persistent requests of a halo.
+*
+* @param h halo
+*/
+void mpiHaloFree( mpi_halo_t *h )
+{
+	int i;
+
+	if (h->send_prev == NULL) return;
+	for (i=0; i<4; i++)
+		MPI_Request_free(&h->req[i]);
+	free(h->send_prev);
+	h->send_prev = h->send_next = h->recv_prev = h->recv_next = NULL;
+	h->count = 0;
+}
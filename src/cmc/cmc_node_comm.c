@@ -0,0 +1,201 @@
+/* vi: set filetype=c.doxygen: */
+#include <stdlib.h>
+#include <mpi.h>
+#include "cmc_node_comm.h"
+
+/* communicators of the processes on this shared-memory node, and of one leader (node rank 0) per node */
+static MPI_Comm nc_node = MPI_COMM_NULL, nc_leaders = MPI_COMM_NULL;
+static int nc_active = 0;
+/* world rank and size, rank and size within the node, and world rank of the node leader */
+static int nc_wrank, nc_wsize, nc_rank, nc_size, nc_first;
+/* number of nodes, and on the leaders the first world rank and the number of processes of every node */
+static int nc_nnodes = 0, *nc_firsts = NULL, *nc_sizes = NULL;
+/* counts and displacements for the collectives of one level */
+static int *nc_cnt = NULL, *nc_dsp = NULL;
+
+/**
+* @brief sets up the node and leader communicators. The two-level collectives are only used if enabled, if the processes of every node are consecutive world ranks (so each node holds a contiguous piece of the arrays), and if there is more than one node and more than one process on some node. Collective over MPI_COMM_WORLD.
+*
+* @param enable whether to use the two-level collectives
+*/
+void node_comm_init(int enable)
+{
+	int contiguous, leader;
+
+	MPI_Comm_rank(MPI_COMM_WORLD, &nc_wrank);
+	MPI_Comm_size(MPI_COMM_WORLD, &nc_wsize);
+	nc_active = 0;
+	if (!enable)
+		return;
+
+	MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, nc_wrank, MPI_INFO_NULL, &nc_node);
+	MPI_Comm_rank(nc_node, &nc_rank);
+	MPI_Comm_size(nc_node, &nc_size);
+	nc_first = nc_wrank;
+	MPI_Bcast(&nc_first, 1, MPI_INT, 0, nc_node);
+
+	contiguous = (nc_first + nc_rank == nc_wrank);
+	MPI_Allreduce(MPI_IN_PLACE, &contiguous, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+	leader = (nc_rank == 0);
+	MPI_Allreduce(&leader, &nc_nnodes, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+	/* the leaders are ordered by world rank, so world rank 0 is leader 0 */
+	MPI_Comm_split(MPI_COMM_WORLD, leader ? 0 : MPI_UNDEFINED, nc_wrank, &nc_leaders);
+	nc_firsts = (int *) malloc(nc_nnodes * sizeof(int));
+	nc_sizes = (int *) malloc(nc_nnodes * sizeof(int));
+	if (leader) {
+		MPI_Allgather(&nc_first, 1, MPI_INT, nc_firsts, 1, MPI_INT, nc_leaders);
+		MPI_Allgather(&nc_size, 1, MPI_INT, nc_sizes, 1, MPI_INT, nc_leaders);
+	}
+	nc_cnt = (int *) malloc((nc_size > nc_nnodes ? nc_size : nc_nnodes) * sizeof(int));
+	nc_dsp = (int *) malloc((nc_size > nc_nnodes ? nc_size : nc_nnodes) * sizeof(int));
+
+	nc_active = contiguous && nc_nnodes > 1 && nc_nnodes < nc_wsize;
+	if (!nc_active)
+		node_comm_free();
+}
+
+/**
+* @brief frees the node and leader communicators; the collectives are flat afterwards
+*/
+void node_comm_free(void)
+{
+	if (nc_node != MPI_COMM_NULL)
+		MPI_Comm_free(&nc_node);
+	if (nc_leaders != MPI_COMM_NULL)
+		MPI_Comm_free(&nc_leaders);
+	free(nc_firsts); nc_firsts = NULL;
+	free(nc_sizes); nc_sizes = NULL;
+	free(nc_cnt); nc_cnt = NULL;
+	free(nc_dsp); nc_dsp = NULL;
+	nc_active = 0;
+}
+
+/**
+* @brief whether the two-level collectives are in use
+*
+* @return 1 if they are, 0 if the collectives are flat
+*/
+int node_comm_active(void)
+{
+	return(nc_active);
+}
+
+/**
+* @brief MPI_Allgatherv over MPI_COMM_WORLD. Two-level if the pieces of consecutive ranks are consecutive in recvbuf (as for the duplicated arrays); sendbuf may be MPI_IN_PLACE.
+*
+* @param sendbuf data of this process, or MPI_IN_PLACE if it is already at its place in recvbuf
+* @param sendcount number of elements of this process
+* @param recvbuf result
+* @param recvcounts number of elements of every process
+* @param displs displacements of the pieces of every process in recvbuf
+* @param type MPI datatype of the elements
+*
+* @return MPI error code
+*/
+int node_allgatherv(const void *sendbuf, int sendcount, void *recvbuf, const int *recvcounts, const int *displs, MPI_Datatype type)
+{
+	MPI_Aint lb, extent;
+	int i, j, total, consecutive = 1;
+	char *base;
+
+	for (i=1; i<nc_wsize; i++)
+		if (displs[i] != displs[i-1] + recvcounts[i-1])
+			consecutive = 0;
+	if (!nc_active || !consecutive)
+		return(MPI_Allgatherv(sendbuf, sendcount, type, recvbuf, recvcounts, displs, type, MPI_COMM_WORLD));
+
+	MPI_Type_get_extent(type, &lb, &extent);
+
+	/* within the node, into the leader's copy */
+	base = (char *) recvbuf + (MPI_Aint) displs[nc_first] * extent;
+	for (i=0; i<nc_size; i++) {
+		nc_cnt[i] = recvcounts[nc_first+i];
+		nc_dsp[i] = displs[nc_first+i] - displs[nc_first];
+	}
+	if (sendbuf != MPI_IN_PLACE)
+		MPI_Gatherv(sendbuf, sendcount, type, base, nc_cnt, nc_dsp, type, 0, nc_node);
+	else if (nc_rank == 0)
+		MPI_Gatherv(MPI_IN_PLACE, 0, type, base, nc_cnt, nc_dsp, type, 0, nc_node);
+	else
+		MPI_Gatherv((char *) recvbuf + (MPI_Aint) displs[nc_wrank] * extent, recvcounts[nc_wrank], type, NULL, NULL, NULL, type, 0, nc_node);
+
+	/* between the leaders, one contiguous piece per node */
+	if (nc_rank == 0) {
+		for (j=0; j<nc_nnodes; j++) {
+			nc_cnt[j] = 0;
+			for (i=0; i<nc_sizes[j]; i++)
+				nc_cnt[j] += recvcounts[nc_firsts[j]+i];
+			nc_dsp[j] = displs[nc_firsts[j]];
+		}
+		MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, recvbuf, nc_cnt, nc_dsp, type, nc_leaders);
+	}
+
+	/* within the node, from the leader */
+	total = displs[nc_wsize-1] + recvcounts[nc_wsize-1] - displs[0];
+	return(MPI_Bcast((char *) recvbuf + (MPI_Aint) displs[0] * extent, total, type, 0, nc_node));
+}
+
+/**
+* @brief MPI_Bcast over MPI_COMM_WORLD, two-level if the root is 0
+*
+* @param buf data
+* @param count number of elements
+* @param type MPI datatype of the elements
+* @param root world rank of the root
+*
+* @return MPI error code
+*/
+int node_bcast(void *buf, int count, MPI_Datatype type, int root)
+{
+	if (!nc_active || root != 0)
+		return(MPI_Bcast(buf, count, type, root, MPI_COMM_WORLD));
+
+	if (nc_rank == 0)
+		MPI_Bcast(buf, count, type, 0, nc_leaders);
+	return(MPI_Bcast(buf, count, type, 0, nc_node));
+}
+
+/**
+* @brief MPI_Gather over MPI_COMM_WORLD with the same count on every process, two-level if the root is 0
+*
+* @param sendbuf data of this process
+* @param count number of elements of every process
+* @param type MPI datatype of the elements
+* @param recvbuf result, on the root
+* @param root world rank of the root
+*
+* @return MPI error code
+*/
+int node_gather(const void *sendbuf, int count, MPI_Datatype type, void *recvbuf, int root)
+{
+	MPI_Aint lb, extent;
+	char *tmp = NULL;
+	int j;
+
+	if (!nc_active || root != 0)
+		return(MPI_Gather(sendbuf, count, type, recvbuf, count, type, root, MPI_COMM_WORLD));
+
+	MPI_Type_get_extent(type, &lb, &extent);
+
+	/* within the node, into the leader; node 0 gathers straight into the result */
+	if (nc_rank == 0)
+		tmp = (nc_wrank == 0) ? (char *) recvbuf : (char *) malloc((size_t) nc_size * count * extent);
+	MPI_Gather(sendbuf, count, type, tmp, count, type, 0, nc_node);
+
+	/* from the leaders to the root */
+	if (nc_rank == 0) {
+		for (j=0; j<nc_nnodes; j++) {
+			nc_cnt[j] = nc_sizes[j] * count;
+			nc_dsp[j] = nc_firsts[j] * count;
+		}
+		if (nc_wrank == 0) {
+			MPI_Gatherv(MPI_IN_PLACE, 0, type, recvbuf, nc_cnt, nc_dsp, type, 0, nc_leaders);
+		} else {
+			MPI_Gatherv(tmp, nc_size * count, type, NULL, NULL, NULL, type, 0, nc_leaders);
+			free(tmp);
+		}
+	}
+
+	return(MPI_SUCCESS);
+}
@@ -0,0 +1,377 @@
+/* vi: set filetype=c.doxygen: */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cmc.h"
+#include "cmc_vars.h"
+#include "bse_wrap.h"
+
+/* Precomputed SSE tracks for SE_TABLE.  Every single star that hasn't been
+ * perturbed (by a collision, mass transfer, rejuvenation, ...) follows the
+ * track of its ZAMS mass, so its state can be interpolated on a (ZAMS mass, age)
+ * grid instead of running it through BSE.  The tracks are only tabulated
+ * up to the formation of a remnant; remnant formation always goes through BSE
+ * since it involves kicks. */
+
+/* number of grid points in ZAMS mass and in age */
+#define SE_TABLE_NM 256
+#define SE_TABLE_NA 1024
+/* ZAMS mass range of the table (in MSUN) */
+#define SE_TABLE_MMIN 0.08
+#define SE_TABLE_MMAX 150.0
+/* age of the first non-zero age grid point (in Myr); ages are log-spaced from here */
+#define SE_TABLE_TMIN 0.01
+/* relative tolerance used to decide if a star is still on its track */
+#define SE_TABLE_RTOL 1.0e-3
+
+/* tabulated quantities; the mass-like ones are stored in units of the ZAMS mass */
+enum { SE_TAB_MASS0, SE_TAB_MT, SE_TAB_RAD, SE_TAB_LUM, SE_TAB_MC, SE_TAB_RC, SE_TAB_MENV,
+	SE_TAB_RENV, SE_TAB_OSPIN, SE_TAB_EPOCH, SE_TAB_TMS, SE_TAB_BHSPIN, SE_TAB_NF };
+
+/* number of entries of the key identifying a table */
+#define SE_TABLE_NKEY 25
+
+static double *se_tab=NULL;
+static int *se_tab_kw=NULL;
+static double se_tab_tmax;
+
+/**
+* @brief age of grid point j of the table
+*
+* @param j age index
+*
+* @return age in Myr
+*/
+static double se_table_age(int j)
+{
+	if (j == 0)
+		return 0.0;
+	return SE_TABLE_TMIN * pow(se_tab_tmax/SE_TABLE_TMIN, (double) (j-1)/(SE_TABLE_NA-2));
+}
+
+/**
+* @brief ZAMS mass of grid point i of the table
+*
+* @param i mass index
+*
+* @return mass in MSUN
+*/
+static double se_table_mass(int i)
+{
+	return SE_TABLE_MMIN * pow(SE_TABLE_MMAX/SE_TABLE_MMIN, (double) i/(SE_TABLE_NM-1));
+}
+
+/**
+* @brief fills the key identifying a table: the grid and every parameter the single-star tracks depend on
+*
+* @param key array of SE_TABLE_NKEY doubles
+*/
+static void se_table_key(double *key)
+{
+	key[0] = SE_TABLE_NM;
+	key[1] = SE_TABLE_NA;
+	key[2] = SE_TABLE_MMIN;
+	key[3] = SE_TABLE_MMAX;
+	key[4] = SE_TABLE_TMIN;
+	key[5] = se_tab_tmax;
+	key[6] = METALLICITY;
+	key[7] = BSE_ZSUN;
+	key[8] = BSE_PTS1;
+	key[9] = BSE_PTS2;
+	key[10] = BSE_PTS3;
+	key[11] = BSE_PTS1_HIGHMASS_CUTOFF;
+	key[12] = BSE_NETA;
+	key[13] = BSE_BWIND;
+	key[14] = BSE_HEWIND;
+	key[15] = BSE_WINDFLAG;
+	key[16] = BSE_EDDLIMFLAG;
+	key[17] = BSE_RTMSFLAG;
+	key[18] = BSE_IFFLAG;
+	key[19] = BSE_WDFLAG;
+	key[20] = BSE_REMNANTFLAG;
+	key[21] = BSE_MXNS;
+	key[22] = BSE_PISN;
+	key[23] = BSE_ST_CR;
+	key[24] = SE_PTS1_WINDOW;
+}
+
+/**
+* @brief builds the table by evolving one star per ZAMS mass through the age grid with BSE. A track is ended (type set to -1) once the star becomes a remnant.
+*/
+static void se_table_build(void)
+{
+	int i, j, jj, kw[2];
+	double mzams, tphys, tphysf, dtp, vs[20], *f;
+	double mass0[2], mt[2], rad[2], lum[2], mc[2], rc[2], menv[2], renv[2], ospin[2];
+	double B_0[2], bacc[2], tacc[2], epoch[2], tms[2], bhspin[2], tb, ecc;
+	bse_context ctx;
+
+	bse_context_init(&ctx, *curr_st);
+	ctx.merger = -1.0;
+	for (i=0; i<SE_TABLE_NM; i++) {
+		mzams = se_table_mass(i);
+		kw[0] = (mzams <= 0.7) ? 0 : 1; kw[1] = 15;
+		mass0[0] = mt[0] = mzams; mass0[1] = mt[1] = 0.0;
+		rad[0] = rad[1] = lum[0] = lum[1] = 0.0;
+		mc[0] = mc[1] = rc[0] = rc[1] = menv[0] = menv[1] = renv[0] = renv[1] = 0.0;
+		ospin[0] = ospin[1] = B_0[0] = B_0[1] = bacc[0] = bacc[1] = tacc[0] = tacc[1] = 0.0;
+		epoch[0] = epoch[1] = tms[0] = tms[1] = bhspin[0] = bhspin[1] = 0.0;
+		tb = ecc = 0.0;
+		tphys = 0.0;
+
+		for (j=0; j<SE_TABLE_NA; j++) {
+			/* the first grid point is the ZAMS as set up by stellar_evolution_init() */
+			tphysf = (j == 0) ? 1.0e-6 : se_table_age(j);
+			dtp = 0.0;
+			/* same MS timestep reduction as in do_stellar_evolution() */
+			ctx.pts1 = se_pts1(kw[0], mzams, tphys, epoch[0], tms[0], tphysf);
+			bse_evolv2_ctx(&ctx, kw, mass0, mt, rad, lum, mc, rc, menv, renv, ospin, B_0, bacc, tacc,
+				epoch, tms, &tphys, &tphysf, &dtp, &METALLICITY, zpars, &tb, &ecc, vs, bhspin);
+			if (kw[0] >= 10) {
+				for (jj=j; jj<SE_TABLE_NA; jj++)
+					se_tab_kw[i*SE_TABLE_NA+jj] = -1;
+				break;
+			}
+			f = &se_tab[(i*SE_TABLE_NA+j)*SE_TAB_NF];
+			se_tab_kw[i*SE_TABLE_NA+j] = kw[0];
+			f[SE_TAB_MASS0] = mass0[0] / mzams;
+			f[SE_TAB_MT] = mt[0] / mzams;
+			f[SE_TAB_RAD] = rad[0];
+			f[SE_TAB_LUM] = lum[0];
+			f[SE_TAB_MC] = mc[0] / mzams;
+			f[SE_TAB_RC] = rc[0];
+			f[SE_TAB_MENV] = menv[0] / mzams;
+			f[SE_TAB_RENV] = renv[0];
+			f[SE_TAB_OSPIN] = ospin[0];
+			f[SE_TAB_EPOCH] = epoch[0];
+			f[SE_TAB_TMS] = tms[0];
+			f[SE_TAB_BHSPIN] = bhspin[0];
+		}
+	}
+}
+
+/**
+* @brief reads the table from a cache file, if it was built with the same key
+*
+* @param fname name of cache file
+*
+* @return 1 if the table was read, 0 otherwise
+*/
+static int se_table_read(char *fname)
+{
+	FILE *fp;
+	double key[SE_TABLE_NKEY], filekey[SE_TABLE_NKEY];
+	size_t n=SE_TABLE_NM*SE_TABLE_NA;
+	int ok;
+
+	if ((fp = fopen(fname, "rb")) == NULL)
+		return 0;
+
+	se_table_key(key);
+	ok = (fread(filekey, sizeof(double), SE_TABLE_NKEY, fp) == SE_TABLE_NKEY) &&
+		(memcmp(key, filekey, sizeof(key)) == 0) &&
+		(fread(se_tab_kw, sizeof(int), n, fp) == n) &&
+		(fread(se_tab, sizeof(double), n*SE_TAB_NF, fp) == n*SE_TAB_NF);
+	fclose(fp);
+
+	return ok;
+}
+
+/**
+* @brief writes the table to a cache file
+*
+* @param fname name of cache file
+*/
+static void se_table_write(char *fname)
+{
+	FILE *fp;
+	double key[SE_TABLE_NKEY];
+	size_t n=SE_TABLE_NM*SE_TABLE_NA;
+
+	if ((fp = fopen(fname, "wb")) == NULL) {
+		wprintf("cannot write SSE track table to \"%s\"\n", fname);
+		return;
+	}
+	se_table_key(key);
+	fwrite(key, sizeof(double), SE_TABLE_NKEY, fp);
+	fwrite(se_tab_kw, sizeof(int), n, fp);
+	fwrite(se_tab, sizeof(double), n*SE_TAB_NF, fp);
+	fclose(fp);
+}
+
+/**
+* @brief sets up the SSE track table for SE_TABLE. The root node reads it from SE_TABLE_FILE if possible, and builds (and caches) it otherwise; it is then broadcast to all nodes. Must be called after BSE has been configured.
+*/
+void se_table_init(void)
+{
+	size_t n=SE_TABLE_NM*SE_TABLE_NA;
+	int found=0;
+
+	/* the table has to cover the whole run */
+	se_tab_tmax = MAX(T_MAX_PHYS * 1000.0, 2.0 * SE_TABLE_TMIN);
+
+	se_tab_kw = (int *) malloc(n * sizeof(int));
+	se_tab = (double *) malloc(n * SE_TAB_NF * sizeof(double));
+
+	if (myid == 0) {
+		if (SE_TABLE_FILE != NULL)
+			found = se_table_read(SE_TABLE_FILE);
+		if (!found) {
+			dprintf("building SSE track table (%d masses, %d ages)\n", SE_TABLE_NM, SE_TABLE_NA);
+			se_table_build();
+			if (SE_TABLE_FILE != NULL)
+				se_table_write(SE_TABLE_FILE);
+		}
+	}
+
+	double tmpTimeStart = timeStartSimple();
+	MPI_Bcast(se_tab_kw, n, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(se_tab, n*SE_TAB_NF, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+	timeEndSimple(tmpTimeStart, &t_comm);
+}
+
+/**
+* @brief frees the SSE track table
+*/
+void se_table_free(void)
+{
+	free(se_tab); se_tab = NULL;
+	free(se_tab_kw); se_tab_kw = NULL;
+}
+
+/**
+* @brief interpolates the table bilinearly in (log ZAMS mass, age). Fails if the point is outside of the table or if the stellar types at the four surrounding grid points differ, i.e. there is a type change or the end of a track nearby.
+*
+* @param mzams ZAMS mass (in MSUN)
+* @param t age (in Myr)
+* @param kw stellar type at the point
+* @param f interpolated quantities (SE_TAB_NF), the mass-like ones in MSUN
+*
+* @return 1 on success, 0 otherwise
+*/
+static int se_table_lookup(double mzams, double t, int *kw, double *f)
+{
+	int i, j, l, c;
+	double x, y, w[4];
+	int idx[4];
+
+	if (mzams < SE_TABLE_MMIN || mzams >= SE_TABLE_MMAX || t < 0.0 || t >= se_tab_tmax)
+		return 0;
+
+	x = log(mzams/SE_TABLE_MMIN) / log(SE_TABLE_MMAX/SE_TABLE_MMIN) * (SE_TABLE_NM-1);
+	i = MIN((int) x, SE_TABLE_NM-2);
+	x -= i;
+	if (t < SE_TABLE_TMIN) {
+		j = 0;
+		y = t / SE_TABLE_TMIN;
+	} else {
+		y = 1.0 + log(t/SE_TABLE_TMIN) / log(se_tab_tmax/SE_TABLE_TMIN) * (SE_TABLE_NA-2);
+		j = MIN((int) y, SE_TABLE_NA-2);
+		y = (t - se_table_age(j)) / (se_table_age(j+1) - se_table_age(j));
+	}
+
+	idx[0] = i*SE_TABLE_NA+j; w[0] = (1.0-x)*(1.0-y);
+	idx[1] = i*SE_TABLE_NA+j+1; w[1] = (1.0-x)*y;
+	idx[2] = (i+1)*SE_TABLE_NA+j; w[2] = x*(1.0-y);
+	idx[3] = (i+1)*SE_TABLE_NA+j+1; w[3] = x*y;
+
+	*kw = se_tab_kw[idx[0]];
+	if (*kw < 0)
+		return 0;
+	for (c=1; c<4; c++)
+		if (se_tab_kw[idx[c]] != *kw)
+			return 0;
+
+	for (l=0; l<SE_TAB_NF; l++) {
+		f[l] = 0.0;
+		for (c=0; c<4; c++)
+			f[l] += w[c] * se_tab[idx[c]*SE_TAB_NF+l];
+	}
+	f[SE_TAB_MASS0] *= mzams;
+	f[SE_TAB_MT] *= mzams;
+	f[SE_TAB_MC] *= mzams;
+	f[SE_TAB_MENV] *= mzams;
+
+	return 1;
+}
+
+/**
+* @brief interpolates the state of single star k at time tphysf from the SSE track table. This only succeeds if the star's current state still matches its unperturbed track (so it hasn't collided, accreted mass or been rejuvenated), and it doesn't change type before tphysf.
+*
+* @param k index of star
+* @param tphysf time (in Myr) to evolve to
+* @param f interpolated quantities at tphysf (SE_TAB_NF)
+*
+* @return 1 on success, 0 if the star needs the full BSE call
+*/
+static int se_table_interp(long k, double tphysf, double *f)
+{
+	int kw;
+
+	if (star[k].se_k >= 10)
+		return 0;
+
+	/* is the star still on its track? */
+	if (!se_table_lookup(star[k].se_zams_mass, star[k].se_tphys, &kw, f))
+		return 0;
+	if (kw != star[k].se_k ||
+			fabs(f[SE_TAB_MT] - star[k].se_mt) > SE_TABLE_RTOL * star[k].se_mt ||
+			fabs(f[SE_TAB_MASS0] - star[k].se_mass) > SE_TABLE_RTOL * star[k].se_mass ||
+			fabs(f[SE_TAB_EPOCH] - star[k].se_epoch) > SE_TABLE_RTOL * MAX(star[k].se_tphys, 1.0))
+		return 0;
+
+	/* and does it stay in the same phase until tphysf? */
+	if (!se_table_lookup(star[k].se_zams_mass, tphysf, &kw, f) || kw != star[k].se_k)
+		return 0;
+
+	return 1;
+}
+
+/**
+* @brief whether single star k can be evolved to time tphysf with se_table_evolve()
+*
+* @param k index of star
+* @param tphysf time (in Myr) to evolve to
+*
+* @return 1 if the table covers the star, 0 otherwise
+*/
+int se_table_covers(long k, double tphysf)
+{
+	double f[SE_TAB_NF];
+
+	return se_table_interp(k, tphysf, f);
+}
+
+/**
+* @brief evolves single star k to time tphysf by interpolating the SSE track table, see se_table_interp()
+*
+* @param k index of star
+* @param tphysf time (in Myr) to evolve to
+*
+* @return 1 if the star was updated, 0 if it needs the full BSE call
+*/
+int se_table_evolve(long k, double tphysf)
+{
+	double f[SE_TAB_NF];
+
+	if (!se_table_interp(k, tphysf, f))
+		return 0;
+
+	star[k].se_mass = f[SE_TAB_MASS0];
+	star[k].se_mt = f[SE_TAB_MT];
+	star[k].se_radius = f[SE_TAB_RAD];
+	star[k].se_lum = f[SE_TAB_LUM];
+	star[k].se_mc = f[SE_TAB_MC];
+	star[k].se_rc = f[SE_TAB_RC];
+	star[k].se_menv = f[SE_TAB_MENV];
+	star[k].se_renv = f[SE_TAB_RENV];
+	star[k].se_ospin = f[SE_TAB_OSPIN];
+	star[k].se_epoch = f[SE_TAB_EPOCH];
+	star[k].se_tms = f[SE_TAB_TMS];
+	star[k].se_bhspin = f[SE_TAB_BHSPIN];
+	star[k].se_tphys = tphysf;
+
+	return 1;
+}
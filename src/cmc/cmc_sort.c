@@ -4,6 +4,7 @@
 #include "cmc_vars.h"
 #include <math.h>
 #include <time.h>
+#include <limits.h>
 
 #if (defined(USE_THREADS) || defined(USE_THREADS_SORT))
 
@@ -353,6 +354,308 @@ void remove_stripped_stars(type* buf, int* local_N)
 	}
 }
 
+/* receive and packing buffers of sample_sort() and load_balance(), kept across timesteps. They are sized
+   by the actual counts and only grow (geometrically), so after the first few sorts nothing is allocated. */
+static struct {
+	type		*stars;	/* stars received in the sample sort */
+	size_t	stars_size;
+	binary_t	*bins;	/* binaries received in the sample sort, 1-based like the binary array */
+	size_t	bins_size;
+	binary_t	*pack;	/* binaries packed by destination in load_balance() */
+	size_t	pack_size;
+	double	*msg_send;	/* stars and binaries packed by destination in sample_sort(), in units of SORT_MSG_UNIT */
+	size_t	msg_send_size;
+	double	*msg_recv;
+	size_t	msg_recv_size;
+} sort_arena = {NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0};
+
+/* stars and binaries are packed into the messages of sample_sort() in units of a double, which keeps them aligned.
+   A star is some 50 units, so the int counts and displacements of these messages overflow far sooner than counts of
+   stars would; sort_msg_units() checks for that. */
+#define SORT_MSG_UNIT sizeof(double)
+#define SORT_MSG_UNITS(size) (((size) + SORT_MSG_UNIT - 1) / SORT_MSG_UNIT)
+
+/**
+* @brief size of a message of sample_sort() holding a number of stars and binaries, in units of SORT_MSG_UNIT. Exits if it does not fit in an int, as MPI needs. Checking the total of all messages to or from a processor makes sure all their counts and displacements fit as well.
+*
+* @param nstars number of stars
+* @param nbins number of binaries
+*
+* @return message size in units of SORT_MSG_UNIT
+*/
+static int sort_msg_units(long nstars, long nbins)
+{
+	long n = nstars * (long) SORT_MSG_UNITS(sizeof(type)) + nbins * (long) SORT_MSG_UNITS(sizeof(binary_t));
+
+	if (n > INT_MAX) {
+		eprintf("sort messages of %ld stars and %ld binaries are too large for MPI counts\n", nstars, nbins);
+		exit_cleanly(-1, __FUNCTION__);
+	}
+	return((int) n);
+}
+
+/**
+* @brief makes sure a sort arena buffer holds at least n elements. The contents are not preserved.
+*
+* @param buf the buffer
+* @param size current capacity of the buffer in elements, updated
+* @param n number of elements needed
+* @param elsize size of one element
+*
+* @return the (possibly new) buffer
+*/
+static void *sort_arena_reserve(void *buf, size_t *size, size_t n, size_t elsize)
+{
+	n = MAX(n, 1);
+	if (n <= *size)
+		return(buf);
+
+	*size = MAX(n, 2 * (*size));
+	free(buf);
+	return(malloc((*size) * elsize));
+}
+
+/**
+* @brief number of binaries among n stars
+*
+* @param buf array of stars
+* @param n number of stars
+*
+* @return number of stars with binind > 0
+*/
+static int count_binaries(type *buf, int n)
+{
+	int j, k=0;
+
+	for (j=0; j<n; j++)
+		if (buf[j].binind > 0) k++;
+
+	return(k);
+}
+
+/* splitters of the previous sort, from which SORT_SPLITTER_PREDICT predicts the next ones. procs is 0 if there is
+   no usable previous partition. */
+static struct {
+	keyType	*bound;
+	int		procs;
+} split_prev = {NULL, 0};
+
+/* number of candidate splitters on either side of a predicted one; they span half of the previous bucket */
+#define SPLIT_PREDICT_HALF 8
+
+/**
+* @brief number of keys in a sorted array that are smaller than a given key
+*
+* @param buf sorted array
+* @param n number of elements
+* @param r key
+*
+* @return number of elements with key < r
+*/
+static int count_below(type *buf, int n, keyType r)
+{
+	int lo = 0, hi = n, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (getKey(&buf[mid]) < r)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return(lo);
+}
+
+/**
+* @brief predicts the splitters of sample_sort() from the splitters of the previous sort, since the radial distribution changes little within a timestep. Around each previous splitter a few candidate keys are placed, their global ranks are found with one MPI_Allreduce of the local counts, and the splitter is interpolated between the two candidates that bracket the rank the boundary should have. What is left over is moved between neighbours by load_balance_neighbours().
+*
+* @param buf locally sorted data
+* @param local_N number of local data points
+* @param expected_count number of data points each processor should end up with
+* @param splitterArray the procs-1 splitters
+* @param procs number of processors
+* @param commgroup MPI communication group
+*
+* @return 1 if the splitters were predicted, 0 if there is no previous partition or a boundary has moved out of range of the candidates, in which case they have to be sampled
+*/
+static int predict_splitters(type *buf, int local_N, int *expected_count, keyType *splitterArray, int procs, MPI_Comm commgroup)
+{
+	int i, j, nc = 2*SPLIT_PREDICT_HALF+1, ok = 1;
+	long target, *c, *count;
+	keyType s, lo, hi, *k, *cand;
+
+	if (split_prev.procs != procs || procs < 2)
+		return(0);
+
+	cand = (keyType *) malloc((procs-1) * nc * sizeof(keyType));
+	count = (long *) malloc((procs-1) * nc * sizeof(long));
+	for (i=0; i<procs-1; i++) {
+		s = split_prev.bound[i];
+		lo = (i > 0) ? split_prev.bound[i-1] : 0.0;
+		hi = (i < procs-2) ? split_prev.bound[i+1] : 2.0 * s - lo;
+		for (j=-SPLIT_PREDICT_HALF; j<=SPLIT_PREDICT_HALF; j++) {
+			cand[i*nc + j+SPLIT_PREDICT_HALF] = s + ((j < 0) ? s - lo : hi - s) * j / (2.0 * SPLIT_PREDICT_HALF);
+			count[i*nc + j+SPLIT_PREDICT_HALF] = count_below(buf, local_N, cand[i*nc + j+SPLIT_PREDICT_HALF]);
+		}
+	}
+
+	double tmpTimeStart = timeStartSimple();
+	MPI_Allreduce(MPI_IN_PLACE, count, (procs-1) * nc, MPI_LONG, MPI_SUM, commgroup);
+	timeEndSimple(tmpTimeStart, &t_comm);
+
+	target = 0;
+	for (i=0; i<procs-1; i++) {
+		target += expected_count[i];
+		c = count + i*nc;
+		k = cand + i*nc;
+		if (target < c[0] || target > c[nc-1]) {
+			ok = 0;
+			break;
+		}
+		for (j=0; j<nc-2 && c[j+1] < target; j++);
+		s = (c[j+1] == c[j]) ? k[j] : k[j] + (k[j+1] - k[j]) * (target - c[j]) / (c[j+1] - c[j]);
+		splitterArray[i] = (i > 0 && s < splitterArray[i-1]) ? splitterArray[i-1] : s;
+	}
+
+	free(cand);
+	free(count);
+	return(ok);
+}
+
+/**
+* @brief after a sample sort with predicted splitters, moves the residual between neighbouring processors so the number of stars on each is in accordance with the data partitioning scheme. Each neighbour gets one message with its stars, each followed by its binary if it has one. Does nothing and returns 0 if some processor would have to send to a processor other than its neighbours; load_balance() has to be used then. The decision is the same on all processors.
+*
+* @param inbuf stars after the sample sort
+* @param outbuf star array + 1, the result
+* @param b_inbuf binaries of inbuf, 1-based
+* @param b_outbuf binary array + 1, the result
+* @param expected_count number of stars each processor should end up with
+* @param actual_count number of stars on each processor after the sample sort; the entry of this processor is updated
+* @param myid rank of this processor
+* @param procs number of processors
+* @param commgroup MPI communication group
+*
+* @return 1 if the stars were balanced, 0 otherwise
+*/
+static int load_balance_neighbours(type *inbuf, type *outbuf, binary_t *b_inbuf, binary_t *b_outbuf, int *expected_count, int *actual_count, int myid, int procs, MPI_Comm commgroup)
+{
+	long i, a, e, a_me = 0, e_me = 0, e_next = 0;
+	int j, k, n_left = 0, n_right = 0, from_left = 0, from_right = 0, kept, nbin, nunits[2], neigh[2], nmsg = 0;
+	int star_units = SORT_MSG_UNITS(sizeof(type)), bin_units = SORT_MSG_UNITS(sizeof(binary_t));
+	double *msg;
+	MPI_Request req[2];
+	MPI_Status stat;
+
+	/* global index of the first star each processor has (a) and should have (e), checking that every processor's stars
+	   lie within the buckets of its neighbours */
+	a = e = 0;
+	for (i=0; i<procs; i++) {
+		if (actual_count[i] > 0 && (a < e - (i > 0 ? expected_count[i-1] : 0) ||
+		                            a + actual_count[i] > e + expected_count[i] + (i < procs-1 ? expected_count[i+1] : 0)))
+			return(0);
+		if (i == myid) {
+			a_me = a;
+			e_me = e;
+			e_next = e + expected_count[i];
+		}
+		/* what the left neighbour sends to the right, and the right neighbour to the left */
+		if (i == myid-1)
+			from_left = (int) MAX(0, MIN(actual_count[i], a + actual_count[i] - (e + expected_count[i])));
+		if (i == myid+1)
+			from_right = (int) MAX(0, MIN(actual_count[i], e - a));
+		a += actual_count[i];
+		e += expected_count[i];
+	}
+	n_left = (int) MAX(0, MIN(actual_count[myid], e_me - a_me));
+	n_right = (int) MAX(0, MIN(actual_count[myid], a_me + actual_count[myid] - e_next));
+	kept = actual_count[myid] - n_left - n_right;
+
+	/* pack and send the stars below the bucket of this processor to the left, those above it to the right */
+	neigh[0] = myid-1;
+	neigh[1] = myid+1;
+	nbin = count_binaries(inbuf, n_left);
+	nunits[0] = n_left * star_units + nbin * bin_units;
+	nunits[1] = sort_msg_units(n_left + n_right, nbin + count_binaries(inbuf + actual_count[myid] - n_right, n_right)) - nunits[0];
+	sort_arena.msg_send = (double *) sort_arena_reserve(sort_arena.msg_send, &sort_arena.msg_send_size, nunits[0] + nunits[1], SORT_MSG_UNIT);
+	msg = sort_arena.msg_send;
+	for (j=0; j<actual_count[myid]; j++) {
+		if (j >= n_left && j < n_left + kept)
+			continue;
+		memcpy(msg, &inbuf[j], sizeof(type));
+		msg += star_units;
+		if (inbuf[j].binind > 0) {
+			memcpy(msg, &b_inbuf[inbuf[j].binind], sizeof(binary_t));
+			msg += bin_units;
+		}
+	}
+
+	MPI_Datatype msgType;
+	MPI_Type_contiguous(SORT_MSG_UNIT, MPI_BYTE, &msgType);
+	MPI_Type_commit(&msgType);
+	double tmpTimeStart3 = timeStartSimple();
+	for (i=0; i<2; i++)
+		if (nunits[i] > 0)
+			MPI_Isend(sort_arena.msg_send + (i ? nunits[0] : 0), nunits[i], msgType, neigh[i], 0, commgroup, &req[nmsg++]);
+
+	/* the receive sizes depend on the binaries, which only the sender knows */
+	int rcount[2] = {0, 0}, from[2] = {from_left, from_right};
+	for (i=0; i<2; i++)
+		if (from[i] > 0) {
+			MPI_Probe(neigh[i], 0, commgroup, &stat);
+			MPI_Get_count(&stat, msgType, &rcount[i]);
+		}
+	sort_arena.msg_recv = (double *) sort_arena_reserve(sort_arena.msg_recv, &sort_arena.msg_recv_size, rcount[0] + rcount[1], SORT_MSG_UNIT);
+	for (i=0; i<2; i++)
+		if (from[i] > 0)
+			MPI_Recv(sort_arena.msg_recv + (i ? rcount[0] : 0), rcount[i], msgType, neigh[i], 0, commgroup, MPI_STATUS_IGNORE);
+	MPI_Waitall(nmsg, req, MPI_STATUSES_IGNORE);
+	timeEndSimple(tmpTimeStart3, &t_comm);
+	MPI_Type_free(&msgType);
+
+	/* the kept stars and their binaries go between those from the left and those from the right */
+	nbin = (rcount[0] - from_left * star_units) / bin_units + count_binaries(inbuf + n_left, kept) + (rcount[1] - from_right * star_units) / bin_units;
+	if(star_array_reserve(from_left + kept + from_right + 2))
+		outbuf = star + 1;
+	if(binary_array_reserve(nbin + 1))
+		b_outbuf = binary + 1;
+
+	//MPI: k starts from 1 because binind has to be > 0 for binaries, and also the 0th element in the binary array is not to be used.
+	k = 1;
+	msg = sort_arena.msg_recv;
+	for (j=0; j<from_left; j++) {
+		memcpy(&outbuf[j], msg, sizeof(type));
+		msg += star_units;
+		if (outbuf[j].binind > 0) {
+			memcpy(&b_outbuf[k-1], msg, sizeof(binary_t));
+			msg += bin_units;
+			outbuf[j].binind = k++;
+		}
+	}
+	memcpy(&outbuf[from_left], &inbuf[n_left], kept * sizeof(type));
+	for (j=from_left; j<from_left+kept; j++)
+		if (outbuf[j].binind > 0) {
+			memcpy(&b_outbuf[k-1], &b_inbuf[outbuf[j].binind], sizeof(binary_t));
+			outbuf[j].binind = k++;
+		}
+	for (j=from_left+kept; j<from_left+kept+from_right; j++) {
+		memcpy(&outbuf[j], msg, sizeof(type));
+		msg += star_units;
+		if (outbuf[j].binind > 0) {
+			memcpy(&b_outbuf[k-1], msg, sizeof(binary_t));
+			msg += bin_units;
+			outbuf[j].binind = k++;
+		}
+	}
+	if(k-1 != nbin || msg - sort_arena.msg_recv != rcount[0] + rcount[1])
+		eprintf("Binary numbers mismatch in proc %d j = %d recv_cnt = %d\n", myid, k-1, nbin);
+
+	N_b_local = nbin;
+	actual_count[myid] = from_left + kept + from_right;
+	dprintf("after load-balancing stars in proc %d = %d expected_count = %d\n", myid, actual_count[myid], expected_count[myid]);
+
+	return(1);
+}
+
 // NEWER VERSION OF SAMPLE SORT WITH CLEANER LOAD BALANCING FUNCTION
 /**
 * @brief Parallel sample sort. Following are the steps:
@@ -362,6 +665,7 @@ void remove_stripped_stars(type* buf, int* local_N)
 * 4. All processors have an all-to-all communication and exchange data
 * 5. Each processor sorts the received chunks of data which completes the sort
 * 6. Since the number of points ending up on each processor is non-deterministic, an optional phase is to exchange data between processors so that the number of data points on each processor is in accordance with out data partitioning scheme.
+* With SORT_SPLITTER_PREDICT, steps 2 and 3 are replaced by predict_splitters() whenever the previous partition allows it, and step 6 then only moves the residual between neighbouring processors (load_balance_neighbours()) unless it is too large for that.
 * @param buf the local data set (star) which is a part of the entire data set which is divided among many processors which is to be sorted in parallel
 * @param local_N number of local data points
 * @param dataType MPI datatype for the star data structure
@@ -390,7 +694,6 @@ int sample_sort( type	      *buf,
 	int  			  	*send_index;
 	int  	  			*send_count, *recv_count;
 	int				total_recv_count;
-	int				max_alloc_outbuf_size;
 	int 				*actual_count;
 	int 				*expected_count;
 	keyType			*sampleKeyArray_local;
@@ -421,33 +724,40 @@ int sample_sort( type	      *buf,
 	find_expected_count( expected_count, global_N, procs );
 	timeEndSimple(tmpTimeStart2, &t_sort_oth);
 
-	/* Picking samples from the local data set */
-	tmpTimeStart2 = timeStartSimple();
-	sampleKeyArray_local = (keyType*) malloc(n_samples * sizeof(keyType));
-	sample(buf, sampleKeyArray_local, *local_N, n_samples);
-
-	/* root node gathers the samples from all nodes */
-	sampleKeyArray_all = (keyType*) malloc(procs * n_samples * sizeof(keyType));
-	tmpTimeStart3 = timeStartSimple();
-	MPI_Gather(sampleKeyArray_local, n_samples * sizeof(keyType), MPI_BYTE, sampleKeyArray_all, n_samples * sizeof(keyType), MPI_BYTE, 0, commgroup);
-	timeEndSimple(tmpTimeStart3, &t_comm);
-
 	/* procs-1 numbers are enough for p buckets (1 bucket/processor) */
+	tmpTimeStart2 = timeStartSimple();
 	splitterArray = (keyType*) malloc((procs-1) * sizeof(keyType));
 
-	/* Sorting the collected samples and determining splitters */
-	if(myid==0)
+	int predicted = SORT_SPLITTER_PREDICT && predict_splitters(buf, *local_N, expected_count, splitterArray, procs, commgroup);
+	if (!predicted)
 	{
-		qsort( sampleKeyArray_all, procs*n_samples, sizeof(keyType), compare_keyType );
+		/* Picking samples from the local data set */
+		sampleKeyArray_local = (keyType*) malloc(n_samples * sizeof(keyType));
+		sample(buf, sampleKeyArray_local, *local_N, n_samples);
+
+		/* root node gathers the samples from all nodes */
+		sampleKeyArray_all = (keyType*) malloc(procs * n_samples * sizeof(keyType));
+		tmpTimeStart3 = timeStartSimple();
+		node_gather(sampleKeyArray_local, n_samples * sizeof(keyType), MPI_BYTE, sampleKeyArray_all, 0);
+		timeEndSimple(tmpTimeStart3, &t_comm);
+
+		/* Sorting the collected samples and determining splitters */
+		if(myid==0)
+		{
+			qsort( sampleKeyArray_all, procs*n_samples, sizeof(keyType), compare_keyType );
 
-		for(i=0; i<procs-1; i++)
-			splitterArray[i] = sampleKeyArray_all[ (i+1) * n_samples - 1 ];
-	}
+			for(i=0; i<procs-1; i++)
+				splitterArray[i] = sampleKeyArray_all[ (i+1) * n_samples - 1 ];
+		}
 
-	/* sending back splitters to all nodes */
-	tmpTimeStart3 = timeStartSimple();
-	MPI_Bcast(splitterArray, (procs-1) * sizeof(keyType), MPI_BYTE, 0, MPI_COMM_WORLD);
-	timeEndSimple(tmpTimeStart3, &t_comm);
+		/* sending back splitters to all nodes */
+		tmpTimeStart3 = timeStartSimple();
+		node_bcast(splitterArray, (procs-1) * sizeof(keyType), MPI_BYTE, 0);
+		timeEndSimple(tmpTimeStart3, &t_comm);
+
+		free(sampleKeyArray_all);
+		free(sampleKeyArray_local);
+	}
 
 	/* find the offset index for each send using binary search on splitter array */
 	send_index = (int *) calloc(procs, sizeof(int));
@@ -456,9 +766,17 @@ int sample_sort( type	      *buf,
 	for (i=1; i<procs; i++)
 		send_index[i] = binary_search(buf, splitterArray[i-1], 0, (*local_N)-1);
 
-	free(sampleKeyArray_all);
-	free(sampleKeyArray_local);
-	free(splitterArray);
+	/* the splitters are kept to predict those of the next sort */
+	if (SORT_SPLITTER_PREDICT) {
+		free(split_prev.bound);
+		split_prev.bound = splitterArray;
+		split_prev.procs = procs;
+		for (i=0; i<procs-1; i++)
+			if (splitterArray[i] < 0.0 || (i > 0 && splitterArray[i] < splitterArray[i-1]))
+				split_prev.procs = 0;
+	} else {
+		free(splitterArray);
+	}
 	timeEndSimple(tmpTimeStart2, &t_sort_splitters);
 
 	tmpTimeStart2 = timeStartSimple();
@@ -470,20 +788,62 @@ int sample_sort( type	      *buf,
 
 	send_count[procs-1] = (*local_N) - send_index[procs-1]; // + 1;
 
-	/* exchange the send counts to know how many stars are to be received */
+	/* Stars and binaries are exchanged together: the stars of each bucket are packed into a single message per
+	   destination, each star followed by its binary if it has one. The bucket that stays on this processor is not
+	   sent at all, so only binaries whose owner changes are communicated. The number of stars and binaries in each
+	   bucket is exchanged first. */
+	int j, k;
+	int star_units = SORT_MSG_UNITS(sizeof(type));
+	int bin_units = SORT_MSG_UNITS(sizeof(binary_t));
+	int* b_send_count = (int*) calloc(procs, sizeof(int));
+	int* b_recv_count = (int*) malloc(procs * sizeof(int));
+	int* pair_count = (int*) malloc(4 * procs * sizeof(int));
+	for(i=0; i<procs; i++)
+	{
+		for(j=send_index[i]; j<send_index[i]+send_count[i]; j++)
+			if(buf[j].binind > 0) b_send_count[i]++;
+		pair_count[2*i] = send_count[i];
+		pair_count[2*i+1] = b_send_count[i];
+	}
+
+	/* exchange the send counts to know how many stars and binaries are to be received */
 	tmpTimeStart3 = timeStartSimple();
-	MPI_Alltoall(send_count, 1, MPI_INT, recv_count, 1, MPI_INT, commgroup);
+	MPI_Alltoall(pair_count, 2, MPI_INT, pair_count + 2*procs, 2, MPI_INT, commgroup);
 	timeEndSimple(tmpTimeStart3, &t_comm);
 
-	/* calculate total number of stars to be received on this node */
+	/* calculate total number of stars and binaries to be received on this node */
 	total_recv_count = 0;
-	for (i=0; i<procs; i++) total_recv_count += recv_count[i];
+	int b_total_recv_count = 0;
+	for (i=0; i<procs; i++)
+	{
+		recv_count[i] = pair_count[2*procs + 2*i];
+		b_recv_count[i] = pair_count[2*procs + 2*i + 1];
+		total_recv_count += recv_count[i];
+		b_total_recv_count += b_recv_count[i];
+	}
+	free(pair_count);
 
-	/* calculate the receive displacements for the mpi communication */
+	/* calculate the receive displacements for stars and binaries (binaries start at 1), and the message sizes and displacements */
+	int b_total_send_count = 0;
+	for(i=0; i<procs; i++)
+		b_total_send_count += b_send_count[i];
+	sort_msg_units((*local_N) - send_count[myid], b_total_send_count - b_send_count[myid]);
+	sort_msg_units(total_recv_count - recv_count[myid], b_total_recv_count - b_recv_count[myid]);
 	int* recv_displ = (int*) malloc(procs * sizeof(int));
-	recv_displ[0] = 0;
-	for(i=1; i<procs; i++)
-		recv_displ[i] = recv_displ[i-1] + recv_count[i-1];
+	int* b_recv_displ = (int*) malloc(procs * sizeof(int));
+	int* msg_send_count = (int*) malloc(procs * sizeof(int));
+	int* msg_send_displ = (int*) malloc(procs * sizeof(int));
+	int* msg_recv_count = (int*) malloc(procs * sizeof(int));
+	int* msg_recv_displ = (int*) malloc(procs * sizeof(int));
+	for(i=0; i<procs; i++)
+	{
+		recv_displ[i] = (i == 0) ? 0 : recv_displ[i-1] + recv_count[i-1];
+		b_recv_displ[i] = (i == 0) ? 1 : b_recv_displ[i-1] + b_recv_count[i-1];
+		msg_send_count[i] = (i == myid) ? 0 : send_count[i] * star_units + b_send_count[i] * bin_units;
+		msg_recv_count[i] = (i == myid) ? 0 : recv_count[i] * star_units + b_recv_count[i] * bin_units;
+		msg_send_displ[i] = (i == 0) ? 0 : msg_send_displ[i-1] + msg_send_count[i-1];
+		msg_recv_displ[i] = (i == 0) ? 0 : msg_recv_displ[i-1] + msg_recv_count[i-1];
+	}
 
 	/* find the actual counts on each processor - to be used later too */
 	actual_count = (int*) malloc(procs * sizeof(int));
@@ -491,100 +851,88 @@ int sample_sort( type	      *buf,
 	MPI_Allgather( &total_recv_count, 1, MPI_INT, actual_count, 1, MPI_INT, commgroup );
 	timeEndSimple(tmpTimeStart3, &t_comm);
 
-	/* finding the maximum size of resultBuf to be allocated */
-	max_alloc_outbuf_size = 0;
-	for(i=0; i<procs; i++)
-		max_alloc_outbuf_size = (actual_count[i] > max_alloc_outbuf_size) ? actual_count[i] : max_alloc_outbuf_size;
-
-	/* allocate recv buffer */
-	resultBuf = (type*) malloc(actual_count[myid] * sizeof(type)); 
-
-	/* all to all communication */
-	tmpTimeStart3 = timeStartSimple();
-	MPI_Alltoallv(buf, send_count, send_index, dataType, resultBuf, recv_count, recv_displ, dataType, commgroup);
-	timeEndSimple(tmpTimeStart3, &t_comm);
-
-	dprintf("new no.of stars in proc %d = %d\n", myid, total_recv_count);
-
-
-
-
-	/***** Binary data *****/
-	/* Now, we also have to send the binaries to the appropriate processor. For each bucket, we go over the single stars, and using their binind values, pack together all binaries that need to go to the appropriate processor. Once this is done for all buckets in each processor, we do an all to all communication and we're done. We also make sure the binind values are set appropriately. */
-	int* b_send_index = (int*) malloc(procs * sizeof(int));
-	int* b_send_count = (int*) malloc(procs * sizeof(int));
-	int* b_recv_count = (int*) malloc(procs * sizeof(int));
-/* buffer to pack binaries such that the binaries of each bucket are packet together and in sequence*/
-	binary_t* b_tmp_buf = (binary_t*) malloc(N_BIN_DIM_OPT * sizeof(binary_t));
+	/* recv buffers */
+	sort_arena.stars = (type *) sort_arena_reserve(sort_arena.stars, &sort_arena.stars_size, actual_count[myid], sizeof(type));
+	resultBuf = sort_arena.stars;
+	sort_arena.bins = (binary_t *) sort_arena_reserve(sort_arena.bins, &sort_arena.bins_size, b_total_recv_count+1, sizeof(binary_t));
+	binary_t* b_resultBuf = sort_arena.bins;
+	sort_arena.msg_send = (double *) sort_arena_reserve(sort_arena.msg_send, &sort_arena.msg_send_size, msg_send_displ[procs-1] + msg_send_count[procs-1], SORT_MSG_UNIT);
+	sort_arena.msg_recv = (double *) sort_arena_reserve(sort_arena.msg_recv, &sort_arena.msg_recv_size, msg_recv_displ[procs-1] + msg_recv_count[procs-1], SORT_MSG_UNIT);
 
-	int j, k=0;
-	//Iterate over each bucket
-	for(i=0; i<procs;i++)
+	//MPI: pack the buckets of the other processors. binind-1 is used since binary+1 is passed as input to this sorting function.
+	double *msg;
+	for(i=0; i<procs; i++)
 	{
-		b_send_index[i] = k;
-		//Go over the single stars in the bucket
+		if(i == myid) continue;
+		msg = sort_arena.msg_send + msg_send_displ[i];
 		for(j=send_index[i]; j<send_index[i]+send_count[i]; j++)
 		{
-			//If it is a binary, copy it to the buffer
+			memcpy(msg, &buf[j], sizeof(type));
+			msg += star_units;
 			if(buf[j].binind > 0)
 			{
-				//MPI: binind-1 is used since binary+1 is passed as input to this sorting function.
-				memcpy(&b_tmp_buf[k], &b_buf[buf[j].binind-1], sizeof(binary_t));
-				k++;
+				memcpy(msg, &b_buf[buf[j].binind-1], sizeof(binary_t));
+				msg += bin_units;
 			}
 		}
-		//Set the send count for this bucket
-		b_send_count[i] = k - b_send_index[i];
 	}
 
-	//MPI: Set binary array to zeros, if not might cause problems when new stars are created in the next timestep. So it's best to wipe out the older data.
-	memset (b_buf, 0, (N_BIN_DIM_OPT-1) * sizeof(binary_t));
-
-	/* exchange send counts to know how many binaries to receive from each node */
-	tmpTimeStart3 = timeStartSimple();
-	MPI_Alltoall(b_send_count, 1, MPI_INT, b_recv_count, 1, MPI_INT, commgroup);
-	timeEndSimple(tmpTimeStart3, &t_comm);
-
-	/* total receive count for this node */
-	int b_total_recv_count = 0;
-	for (i=0; i<procs; i++) b_total_recv_count += b_recv_count[i];
-
-	/* receive displacement for all to all communication */
-	int* b_recv_displ = (int*) malloc(procs * sizeof(int));
-	b_recv_displ[0] = 0;
-	for(i=1; i<procs; i++)
-		b_recv_displ[i] = b_recv_displ[i-1] + b_recv_count[i-1];
+	//MPI: the bucket that stays on this processor is copied directly. The binind values are fixed while copying: k starts from 1 because binind has to be > 0 for binaries, and also the 0th element in the binary array is not to be used.
+	memcpy(&resultBuf[recv_displ[myid]], &buf[send_index[myid]], send_count[myid] * sizeof(type));
+	k = b_recv_displ[myid];
+	for(j=recv_displ[myid]; j<recv_displ[myid]+recv_count[myid]; j++)
+	{
+		if(resultBuf[j].binind > 0)
+		{
+			memcpy(&b_resultBuf[k], &b_buf[resultBuf[j].binind-1], sizeof(binary_t));
+			resultBuf[j].binind = k;
+			k++;
+		}
+	}
 
-	binary_t* b_resultBuf = (binary_t*) malloc(N_BIN_DIM_OPT * sizeof(binary_t));
+	//MPI: Set binary array to zeros, if not might cause problems when new stars are created in the next timestep. So it's best to wipe out the older data.
+	//MPI: Only the slots up to the highest one that may be in use hold data; b_buf is binary+1.
+	memset (b_buf, 0, (binary_slots_live_end()-1) * sizeof(binary_t));
 
 	/* all to all communication */
+	MPI_Datatype msgType;
+	MPI_Type_contiguous(SORT_MSG_UNIT, MPI_BYTE, &msgType);
+	MPI_Type_commit(&msgType);
 	tmpTimeStart3 = timeStartSimple();
-	MPI_Alltoallv(b_tmp_buf, b_send_count, b_send_index, b_dataType, b_resultBuf+1, b_recv_count, b_recv_displ, b_dataType, commgroup);
+	MPI_Alltoallv(sort_arena.msg_send, msg_send_count, msg_send_displ, msgType, sort_arena.msg_recv, msg_recv_count, msg_recv_displ, msgType, commgroup);
 	timeEndSimple(tmpTimeStart3, &t_comm);
+	MPI_Type_free(&msgType);
 
-	//MPI: Before we do local sort, we need to fix the binary addressing i.e. the binind values.
-	//MPI: k starts from 1 because binind has to be > 0 for binaries. and also the 0th element in the binary array is not to be used.
-	k=1; 
-	int kprev;
+	dprintf("new no.of stars in proc %d = %d\n", myid, total_recv_count);
+
+	//MPI: unpack the messages, fixing the binind values as above.
 	for(i=0; i<procs; i++)
 	{
-		kprev=k;
+		if(i == myid) continue;
+		msg = sort_arena.msg_recv + msg_recv_displ[i];
+		k = b_recv_displ[i];
 		for(j=recv_displ[i]; j<recv_displ[i]+recv_count[i]; j++)
 		{
+			memcpy(&resultBuf[j], msg, sizeof(type));
+			msg += star_units;
 			if(resultBuf[j].binind > 0)
 			{
+				memcpy(&b_resultBuf[k], msg, sizeof(binary_t));
+				msg += bin_units;
 				resultBuf[j].binind = k;
 				k++;
 			}
 		}
 		//MPI: Checks to make sure the right number of binaries are recd.
-		if(k-kprev!=b_recv_count[i]) eprintf("mismatch in proc %d j = %d recv_cnt = %d\n", myid, k-kprev, b_recv_count[i]);
+		if(k-b_recv_displ[i]!=b_recv_count[i] || msg-sort_arena.msg_recv!=msg_recv_displ[i]+msg_recv_count[i])
+			eprintf("mismatch in proc %d j = %d recv_cnt = %d\n", myid, k-b_recv_displ[i], b_recv_count[i]);
 	}
-	//MPI: Additional checks.
-	if(k-1!=b_total_recv_count)
-		eprintf("Binary numbers mismatch in proc %d j = %d recv_cnt = %d\n", myid, k-1, b_total_recv_count);
 
-	/***** End binary data *****/
+	free(b_send_count);
+	free(msg_send_count);
+	free(msg_send_displ);
+	free(msg_recv_count);
+	free(msg_recv_displ);
 	timeEndSimple(tmpTimeStart2, &t_sort_a2a);
 
 
@@ -597,9 +945,11 @@ int sample_sort( type	      *buf,
 	timeEndSimple(tmpTimeStart, &t_sort_only);
 
 
-	/* exchange stars between processors to stay consistent with data partitioning scheme */
+	/* exchange stars between processors to stay consistent with data partitioning scheme; with predicted
+	   splitters only a residual between neighbours is normally left */
 	tmpTimeStart = timeStartSimple();
-	load_balance(resultBuf, buf, b_resultBuf, b_buf, expected_count, actual_count, myid, procs, dataType, b_dataType, commgroup);
+	if (!predicted || !load_balance_neighbours(resultBuf, buf, b_resultBuf, b_buf, expected_count, actual_count, myid, procs, commgroup))
+		load_balance(resultBuf, buf, b_resultBuf, b_buf, expected_count, actual_count, myid, procs, dataType, b_dataType, commgroup);
 	timeEndSimple(tmpTimeStart, &t_sort_lb);
 
 	tmpTimeStart = timeStartSimple();
@@ -614,14 +964,9 @@ int sample_sort( type	      *buf,
 	free(send_count);
 	free(recv_count);
 	free(recv_displ);
-	free(resultBuf);
 
-	free(b_resultBuf);
-	free(b_send_index);
-	free(b_send_count);
 	free(b_recv_count);
 	free(b_recv_displ);
-	free(b_tmp_buf);
 	timeEndSimple(tmpTimeStart, &t_sort_oth);
 	timeEndSimple(tmpTimeStart2, &t_sort_only);
 
@@ -703,6 +1048,10 @@ void load_balance( 	type 				*inbuf,
 	for(i=1; i<procs; i++)
 		recv_displ[i] = recv_displ[i-1] + recv_count[i-1];
 
+	//MPI: outbuf is star+1, which moves if the star array has to grow to hold the received stars (and the sentinel)
+	if(star_array_reserve(total_recv_count + 2))
+		outbuf = star + 1;
+
 	//all to all communication
 	tmpTimeStart3 = timeStartSimple();
 	MPI_Alltoallv(inbuf, send_count, send_index, dataType, outbuf, recv_count, recv_displ, dataType, commgroup);
@@ -718,7 +1067,8 @@ void load_balance( 	type 				*inbuf,
 	int* b_send_index = (int*) malloc(procs * sizeof(int));
 	int* b_send_count = (int*) malloc(procs * sizeof(int));
 	int* b_recv_count = (int*) malloc(procs * sizeof(int));
-	binary_t* b_tmp_buf = (binary_t*) malloc(N_BIN_DIM_OPT * sizeof(binary_t));
+	sort_arena.pack = (binary_t *) sort_arena_reserve(sort_arena.pack, &sort_arena.pack_size, count_binaries(inbuf, local_count), sizeof(binary_t));
+	binary_t* b_tmp_buf = sort_arena.pack;
 
 	int j, k=0;
 	for(i=0; i<procs;i++)
@@ -740,6 +1090,10 @@ void load_balance( 	type 				*inbuf,
 	for (i=0; i<procs; i++) b_total_recv_count += b_recv_count[i];
 	N_b_local = b_total_recv_count;
 
+	//MPI: same for b_outbuf, which is binary+1
+	if(binary_array_reserve(b_total_recv_count + 1))
+		b_outbuf = binary + 1;
+
 	int* b_recv_displ = (int*) malloc(procs * sizeof(int));
 	b_recv_displ[0] = 0;
 	for(i=1; i<procs; i++)
@@ -774,7 +1128,6 @@ void load_balance( 	type 				*inbuf,
 	free(b_send_count);
 	free(b_recv_count);
 	free(b_recv_displ);
-	free(b_tmp_buf);
 
 	/***** End binary data *****/
 
@@ -87,6 +87,10 @@ void restart_stellar_evolution(void){
   /* set collisions matrix */
   bse_instar();
 
+  if (SE_TABLE) {
+    se_table_init();
+  }
+
   /*Set rng to saved rng seed*/
   bse_set_taus113state(*curr_st, 0);
 }
@@ -180,6 +184,10 @@ void stellar_evolution_init(void){
 
   /* set collisions matrix */
   bse_instar();
+
+  if (SE_TABLE) {
+    se_table_init();
+  }
   dprintf("se_init: %g %g %g %d %g %g %g %d %d %d %d %d %d %g %d %g %g %g %g %g %g\n", BSE_NETA, BSE_BWIND, BSE_HEWIND, BSE_WINDFLAG, BSE_PISN, BSE_ALPHA1, BSE_LAMBDAF, BSE_CEFLAG, BSE_TFLAG, BSE_IFFLAG, BSE_WDFLAG, BSE_RTMSFLAG, BSE_BHFLAG, BSE_REMNANTFLAG, BSE_MXNS, BSE_IDUM, BSE_SIGMA, BSE_BHSIGMAFRAC, BSE_BETA, BSE_EDDFAC, BSE_GAMMA, BSE_POLAR_KICK_ANGLE);
 
   for (k=1; k<=mpiEnd-mpiBegin+1; k++) {
@@ -352,6 +360,175 @@ void stellar_evolution_init(void){
 	timeEndSimple(tmpTimeStart, &t_comm);
 }
 
+/**
+* @brief BSE_PTS1 to use for a star. Massive MS stars (ZAMS mass above BSE_PTS1_HIGHMASS_CUTOFF) need a reduced timestep, otherwise we miss the transition from MS to HG to giant, and won't start applying winds for massive stars at the right time. With SE_PTS1_WINDOW>0 the reduction is only applied if the step from tphys to tphysf overlaps a window around the predicted MS turnoff at epoch+tms.
+*
+* @param kw stellar type
+* @param zams_mass ZAMS mass (in MSUN)
+* @param tphys current time of star (in Myr)
+* @param epoch epoch of star (in Myr)
+* @param tms MS lifetime (in Myr)
+* @param tphysf time (in Myr) to evolve to
+*
+* @return timestep parameter pts1
+*/
+double se_pts1(int kw, double zams_mass, double tphys, double epoch, double tms, double tphysf)
+{
+  double tto, w;
+
+  if (!((kw <= 1 || kw == 7) && zams_mass > BSE_PTS1_HIGHMASS_CUTOFF))
+    return BSE_PTS1;
+  if (SE_PTS1_WINDOW <= 0.0 || tms <= 0.0)
+    return BSE_PTS1/10.;
+
+  tto = epoch + tms;
+  w = SE_PTS1_WINDOW * tms;
+  if (tphysf >= tto - w && tphys <= tto + w)
+    return BSE_PTS1/10.;
+  return BSE_PTS1;
+}
+
+/**
+* @brief whether the isolated evolution of a stellar type is analytic in its age, so the full BSE call can be skipped for it (see SE_SKIP_REMNANTS). This covers white dwarfs and black holes; neutron stars are excluded since their spin and field evolution is only done inside evolv2.
+*
+* @param kw stellar type
+*
+* @return 1 if quiescent, 0 otherwise
+*/
+static int se_is_quiescent(int kw)
+{
+  return ((kw >= 10 && kw <= 12) || kw == 14);
+}
+
+/**
+* @brief updates an isolated white dwarf or black hole to time tphysf with a single call to star/hrdiag instead of the full BSE integration. The mass of such a remnant doesn't change, so only the radius, luminosity and core quantities are updated.
+*
+* @param k index of star
+* @param tphysf time (in Myr) to update to
+*
+* @return 1 if the star was updated, 0 if its type or mass would change, in which case the star is left untouched and needs the full BSE call
+*/
+static int se_update_quiescent(long k, double tphysf)
+{
+  int kw=star[k].se_k;
+  double mass=star[k].se_mass, mt=star[k].se_mt, aj, tm, tn, tscls[20], lums[10], GB[10];
+  double r, lum, mc, rc, menv, renv, k2, bhspin=star[k].se_bhspin;
+
+  aj = tphysf - star[k].se_epoch;
+  bse_star(&kw, &mass, &mt, &tm, &tn, tscls, lums, GB, zpars);
+  bse_hrdiag(&mass, &aj, &mt, &tm, &tn, tscls, lums, GB, zpars,
+	     &r, &lum, &kw, &mc, &rc, &menv, &renv, &k2, &bhspin);
+
+  if (kw != star[k].se_k || mt != star[k].se_mt) {
+    return 0;
+  }
+
+  star[k].se_radius = r;
+  star[k].se_lum = lum;
+  star[k].se_mc = mc;
+  star[k].se_rc = rc;
+  star[k].se_menv = menv;
+  star[k].se_renv = renv;
+  star[k].se_tphys = tphysf;
+  return 1;
+}
+
+/**
+* @brief collects the single stars from kstart on that need a full BSE call, up to SE_BATCH_SIZE of them, into batch and evolves them with one call to bse_evolv1_batch. Star kstart is always included.
+*
+* @param kstart index of the first star of the block
+* @param tphysf time (in Myr) to evolve to
+* @param ctx BSE context of the caller
+* @param batch batch to fill
+*/
+static void se_batch_evolve(long kstart, double tphysf, bse_context *ctx, bse_batch *batch)
+{
+  long k, i;
+  int g_k;
+
+  batch->n = 0;
+  for (k=kstart; k<=clus.N_MAX_NEW && batch->n < batch->nmax; k++) {
+    if (k != kstart) {
+      g_k = get_global_idx(k);
+      if (star[k].binind != 0)
+        continue;
+      if (star_m[g_k]<=DBL_MIN && star[k].vr==0. && star[k].vt==0. && star[k].E==0. && star[k].J==0.)
+        continue;
+      if (SE_SKIP_REMNANTS && se_is_quiescent(star[k].se_k) && tphysf < star[k].se_tnext)
+        continue;
+      if (SE_TABLE && se_table_covers(k, tphysf))
+        continue;
+      if (k <= mpiEnd-mpiBegin+1 && !block_timestep_due(star_r[g_k]))
+        continue;
+    }
+    i = batch->n++;
+    batch->idx[i] = k;
+    batch->id[i] = star[k].id;
+    batch->kw[i] = star[k].se_k;
+    batch->mass0[i] = star[k].se_mass;
+    batch->mass[i] = star[k].se_mt;
+    batch->rad[i] = star[k].se_radius;
+    batch->lum[i] = star[k].se_lum;
+    batch->massc[i] = star[k].se_mc;
+    batch->radc[i] = star[k].se_rc;
+    batch->menv[i] = star[k].se_menv;
+    batch->renv[i] = star[k].se_renv;
+    batch->ospin[i] = star[k].se_ospin;
+    batch->B_0[i] = star[k].se_B_0;
+    batch->bacc[i] = star[k].se_bacc;
+    batch->tacc[i] = star[k].se_tacc;
+    batch->epoch[i] = star[k].se_epoch;
+    batch->tms[i] = star[k].se_tms;
+    batch->bhspin[i] = star[k].se_bhspin;
+    batch->tphys[i] = star[k].se_tphys;
+    batch->pts1[i] = se_pts1(star[k].se_k, star[k].se_zams_mass, star[k].se_tphys, star[k].se_epoch, star[k].se_tms, tphysf);
+  }
+
+  ctx->rng = *curr_st;
+  bse_evolv1_batch(ctx, batch, tphysf, 0.0, &METALLICITY, zpars);
+  *curr_st = ctx->rng;
+}
+
+/**
+* @brief copies the results for entry i of an evolved batch back into star k. The bcm outputs go into ctx, so the caller can treat them as after a call to bse_evolv2_ctx.
+*
+* @param k index of star
+* @param batch evolved batch
+* @param i position of the star in the batch
+* @param ctx BSE context of the caller
+* @param vs birth kicks of the star (20)
+*/
+static void se_batch_unpack(long k, bse_batch *batch, long i, bse_context *ctx, double *vs)
+{
+  int ii;
+
+  star[k].se_mass = batch->mass0[i];
+  star[k].se_k = batch->kw[i];
+  star[k].se_mt = batch->mass[i];
+  star[k].se_radius = batch->rad[i];
+  star[k].se_lum = batch->lum[i];
+  star[k].se_mc = batch->massc[i];
+  star[k].se_rc = batch->radc[i];
+  star[k].se_menv = batch->menv[i];
+  star[k].se_renv = batch->renv[i];
+  star[k].se_ospin = batch->ospin[i];
+  star[k].se_B_0 = batch->B_0[i];
+  star[k].se_bacc = batch->bacc[i];
+  star[k].se_tacc = batch->tacc[i];
+  star[k].se_epoch = batch->epoch[i];
+  star[k].se_tms = batch->tms[i];
+  star[k].se_bhspin = batch->bhspin[i];
+  star[k].se_tphys = batch->tphys[i];
+  for (ii=0; ii<20; ii++) {
+    vs[ii] = batch->vs[20*i+ii];
+  }
+
+  ctx->nbcm = batch->nbcm[i];
+  ctx->bcm_B = batch->bcm_B[i];
+  ctx->bcm_formation_found = batch->bcm_formation_found[i];
+  ctx->bcm_formation = batch->bcm_formation[i];
+}
+
 /* note that this routine is called after perturb_stars() and get_positions() */
 /**
 * @brief does stellar evolution using sse and bse packages.
@@ -370,14 +547,26 @@ void do_stellar_evolution(gsl_rng *rng)
   double dM_dt_SE10, dM_dt_SE100, dM_dt_SE1000, dM_dt_SEcore; 
   double mprev0, mprev1, rprev0, rprev1, zamsprev0, zamsprev1, epochprev0, epochprev1, tbprev;
   struct rng_t113_state temp_state;
-  int reduced_timestep=0;
   binary_t tempbinary;
+  bse_context se_ctx;
+  bse_batch se_batch;
+  long se_batch_next=0;
+  int se_batched;
   bse_set_merger(-1.0);
+  /* all BSE calls below go through se_ctx, so the COMMON-block parameters are never changed per star */
+  bse_context_init(&se_ctx, *curr_st);
+  if (SE_BATCH_SIZE > 0) {
+    bse_batch_alloc(&se_batch, SE_BATCH_SIZE);
+  }
   /* double vk, theta; */
 
   //MPI: The serial version runs till N_MAX_NEW+1 to account for the sentinel. But in the parallel version, there is no sentinel, so runs only till N_MAX_NEW.
   for(k=1; k<=clus.N_MAX_NEW; k++){ 
     int g_k = get_global_idx(k);
+    /* with block timesteps, stars in levels that are not due catch up when they are next due;
+       stars created in this step are always evolved */
+    if (k <= mpiEnd-mpiBegin+1 && !block_timestep_due(star_r[g_k]))
+      continue;
     if (star[k].binind == 0) { /* single star */
       tphysf = TotalTime / MEGA_YEAR;
       dtp = tphysf;
@@ -388,139 +577,128 @@ void do_stellar_evolution(gsl_rng *rng)
       if (star_m[get_global_idx(k)]<=DBL_MIN && star[k].vr==0. && star[k].vt==0. && star[k].E==0. && star[k].J==0.){ //ignoring zeroed out stars
         dprintf ("zeroed out star: skipping SE:\n"); 
         dprintf ("k=%ld m=%g r=%g phi=%g vr=%g vt=%g E=%g J=%g\n", k, star_m[g_k], star_r[g_k], star_phi[g_k], star[k].vr, star[k].vt, star[k].E, star[k].J);
+      } else if (SE_SKIP_REMNANTS && se_is_quiescent(star[k].se_k) && tphysf < star[k].se_tnext && se_update_quiescent(k, tphysf)) {
+        /* isolated WD or BH between resyncs: no mass loss, no kicks, only the radius changes */
+        star[k].rad = star[k].se_radius * RSUN / units.l;
+      } else if (SE_TABLE && se_table_evolve(k, tphysf)) {
+        /* unperturbed single star interpolated from the SSE track table: no kicks, since
+         * remnant formation always goes through BSE */
+        DMse += star_m[g_k] * madhoc;
+        star[k].rad = star[k].se_radius * RSUN / units.l;
+        star_m[g_k] = star[k].se_mt * MSUN / units.mstar;
+        DMse -= star_m[g_k] * madhoc;
       } else {
         DMse += star_m[g_k] * madhoc;
-        /* Update star id for pass through. */
-        bse_set_id1_pass(star[k].id);
-        bse_set_id2_pass(0);
-        tempbinary.bse_mass0[0] = star[k].se_mass;
-        tempbinary.bse_mass0[1] = 0.0;
-        tempbinary.bse_kw[0] = star[k].se_k;
-        tempbinary.bse_kw[1] = 15;
-        tempbinary.bse_mass[0] = star[k].se_mt;
-        tempbinary.bse_mass[1] = 0.0;
-        tempbinary.bse_radius[0] = star[k].se_radius;
-        tempbinary.bse_radius[1] = 0.0;
-        tempbinary.bse_lum[0] = star[k].se_lum;
-        tempbinary.bse_lum[1] = 0.0;
-        tempbinary.bse_massc[0] = star[k].se_mc;
-        tempbinary.bse_massc[1] = 0.0;
-        tempbinary.bse_radc[0] = star[k].se_rc;
-        tempbinary.bse_radc[1] = 0.0;
-        tempbinary.bse_menv[0] = star[k].se_menv;
-        tempbinary.bse_menv[1] = 0.0;
-        tempbinary.bse_renv[0] = star[k].se_renv;
-        tempbinary.bse_renv[1] = 0.0;
-        tempbinary.bse_ospin[0] = star[k].se_ospin;
-        tempbinary.bse_ospin[1] = 0.0;
-        tempbinary.bse_B_0[0] = star[k].se_B_0;
-        tempbinary.bse_B_0[1] = 0.0;
-        tempbinary.bse_bacc[0] = star[k].se_bacc;
-        tempbinary.bse_bacc[1] = 0.0;
-        tempbinary.bse_tacc[0] = star[k].se_tacc;
-        tempbinary.bse_tacc[1] = 0.0;
-        tempbinary.bse_epoch[0] = star[k].se_epoch;
-        tempbinary.bse_epoch[1] = 0.0;
-        tempbinary.bse_tms[0] = star[k].se_tms;
-        tempbinary.bse_tms[1] = 0.0;
-        tempbinary.bse_bhspin[0] = star[k].se_bhspin;
-        tempbinary.bse_bhspin[1] = 0.0;
-        tempbinary.bse_tb = 0.0;
-        tempbinary.e = 0.0;
-
-		  /*If we've got a large MS star, we need to reduce the timestep, otherwise
-		   * we miss the transition from MS to HG to giant, and won't start applying
-		   * winds for massive stars at the right time*/
-		  if((star[k].se_k <= 1 || star[k].se_k == 7) & star[k].se_zams_mass > BSE_PTS1_HIGHMASS_CUTOFF){
-			  bse_set_pts1(BSE_PTS1/10.);
-			  reduced_timestep = 1;
-		  }
-        /*
-          bse_evolv1(&(star[k].se_k), &(star[k].se_mass), &(star[k].se_mt), &(star[k].se_radius), 
-          &(star[k].se_lum), &(star[k].se_mc), &(star[k].se_rc), &(star[k].se_menv), 
-          &(star[k].se_renv), &(star[k].se_ospin), &(star[k].se_epoch), &(star[k].se_tms), 
-          &(star[k].se_tphys), &tphysf, &dtp, &METALLICITY, zpars, vs);
-         */
-        bse_set_taus113state(*curr_st, 0);
-        bse_evolv2_safely(&(tempbinary.bse_kw[0]), &(tempbinary.bse_mass0[0]), &(tempbinary.bse_mass[0]), 
-            &(tempbinary.bse_radius[0]), &(tempbinary.bse_lum[0]), &(tempbinary.bse_massc[0]), 
-            &(tempbinary.bse_radc[0]), &(tempbinary.bse_menv[0]), &(tempbinary.bse_renv[0]), 
-            &(tempbinary.bse_ospin[0]), &(tempbinary.bse_B_0[0]), &(tempbinary.bse_bacc[0]), &(tempbinary.bse_tacc[0]), 
-            &(tempbinary.bse_epoch[0]), &(tempbinary.bse_tms[0]), 
-            &(star[k].se_tphys), &tphysf, &dtp, &METALLICITY, zpars, 
-            &(tempbinary.bse_tb), &(tempbinary.e), vs, &(tempbinary.bse_bhspin[0]));
-        *curr_st=bse_get_taus113state();
-
-        star[k].se_mass = tempbinary.bse_mass0[0];
-        star[k].se_k = tempbinary.bse_kw[0];
-        star[k].se_mt = tempbinary.bse_mass[0];
-        star[k].se_radius = tempbinary.bse_radius[0];
-        star[k].se_lum = tempbinary.bse_lum[0];
-        star[k].se_mc = tempbinary.bse_massc[0];
-        star[k].se_rc = tempbinary.bse_radc[0];
-        star[k].se_menv = tempbinary.bse_menv[0];
-        star[k].se_renv = tempbinary.bse_renv[0];
-        star[k].se_ospin = tempbinary.bse_ospin[0];
-        star[k].se_B_0 = tempbinary.bse_B_0[0];
-        star[k].se_bacc = tempbinary.bse_bacc[0];
-        star[k].se_tacc = tempbinary.bse_tacc[0];
-        star[k].se_epoch = tempbinary.bse_epoch[0];
-        star[k].se_tms = tempbinary.bse_tms[0];
-	star[k].se_bhspin = tempbinary.bse_bhspin[0];
-
-		  /*Reset the MS timestep once we're done*/
-		  if(reduced_timestep == 1)
-			  bse_set_pts1(BSE_PTS1);
+        se_batched = 0;
+        if (SE_BATCH_SIZE > 0) {
+          /* skip entries of the current block that are behind k, and evolve the next block once it's used up */
+          while (se_batch_next < se_batch.n && se_batch.idx[se_batch_next] < k) {
+            se_batch_next++;
+          }
+          if (se_batch_next >= se_batch.n) {
+            se_batch_evolve(k, tphysf, &se_ctx, &se_batch);
+            se_batch_next = 0;
+          }
+          if (se_batch.idx[se_batch_next] == k) {
+            se_batch_unpack(k, &se_batch, se_batch_next, &se_ctx, vs);
+            se_batch_next++;
+            se_batched = 1;
+          }
+        }
+        if (!se_batched) {
+          /* Update star id for pass through. */
+          se_ctx.id1_pass = star[k].id;
+          se_ctx.id2_pass = 0;
+          tempbinary.bse_mass0[0] = star[k].se_mass;
+          tempbinary.bse_mass0[1] = 0.0;
+          tempbinary.bse_kw[0] = star[k].se_k;
+          tempbinary.bse_kw[1] = 15;
+          tempbinary.bse_mass[0] = star[k].se_mt;
+          tempbinary.bse_mass[1] = 0.0;
+          tempbinary.bse_radius[0] = star[k].se_radius;
+          tempbinary.bse_radius[1] = 0.0;
+          tempbinary.bse_lum[0] = star[k].se_lum;
+          tempbinary.bse_lum[1] = 0.0;
+          tempbinary.bse_massc[0] = star[k].se_mc;
+          tempbinary.bse_massc[1] = 0.0;
+          tempbinary.bse_radc[0] = star[k].se_rc;
+          tempbinary.bse_radc[1] = 0.0;
+          tempbinary.bse_menv[0] = star[k].se_menv;
+          tempbinary.bse_menv[1] = 0.0;
+          tempbinary.bse_renv[0] = star[k].se_renv;
+          tempbinary.bse_renv[1] = 0.0;
+          tempbinary.bse_ospin[0] = star[k].se_ospin;
+          tempbinary.bse_ospin[1] = 0.0;
+          tempbinary.bse_B_0[0] = star[k].se_B_0;
+          tempbinary.bse_B_0[1] = 0.0;
+          tempbinary.bse_bacc[0] = star[k].se_bacc;
+          tempbinary.bse_bacc[1] = 0.0;
+          tempbinary.bse_tacc[0] = star[k].se_tacc;
+          tempbinary.bse_tacc[1] = 0.0;
+          tempbinary.bse_epoch[0] = star[k].se_epoch;
+          tempbinary.bse_epoch[1] = 0.0;
+          tempbinary.bse_tms[0] = star[k].se_tms;
+          tempbinary.bse_tms[1] = 0.0;
+          tempbinary.bse_bhspin[0] = star[k].se_bhspin;
+          tempbinary.bse_bhspin[1] = 0.0;
+          tempbinary.bse_tb = 0.0;
+          tempbinary.e = 0.0;
+
+          /*If we've got a large MS star, we need to reduce the timestep*/
+          se_ctx.pts1 = se_pts1(star[k].se_k, star[k].se_zams_mass, star[k].se_tphys, star[k].se_epoch, star[k].se_tms, tphysf);
+          /*
+            bse_evolv1(&(star[k].se_k), &(star[k].se_mass), &(star[k].se_mt), &(star[k].se_radius), 
+            &(star[k].se_lum), &(star[k].se_mc), &(star[k].se_rc), &(star[k].se_menv), 
+            &(star[k].se_renv), &(star[k].se_ospin), &(star[k].se_epoch), &(star[k].se_tms), 
+            &(star[k].se_tphys), &tphysf, &dtp, &METALLICITY, zpars, vs);
+           */
+          se_ctx.rng = *curr_st;
+          bse_evolv2_ctx(&se_ctx, &(tempbinary.bse_kw[0]), &(tempbinary.bse_mass0[0]), &(tempbinary.bse_mass[0]), 
+              &(tempbinary.bse_radius[0]), &(tempbinary.bse_lum[0]), &(tempbinary.bse_massc[0]), 
+              &(tempbinary.bse_radc[0]), &(tempbinary.bse_menv[0]), &(tempbinary.bse_renv[0]), 
+              &(tempbinary.bse_ospin[0]), &(tempbinary.bse_B_0[0]), &(tempbinary.bse_bacc[0]), &(tempbinary.bse_tacc[0]), 
+              &(tempbinary.bse_epoch[0]), &(tempbinary.bse_tms[0]), 
+              &(star[k].se_tphys), &tphysf, &dtp, &METALLICITY, zpars, 
+              &(tempbinary.bse_tb), &(tempbinary.e), vs, &(tempbinary.bse_bhspin[0]));
+          *curr_st = se_ctx.rng;
+
+          star[k].se_mass = tempbinary.bse_mass0[0];
+          star[k].se_k = tempbinary.bse_kw[0];
+          star[k].se_mt = tempbinary.bse_mass[0];
+          star[k].se_radius = tempbinary.bse_radius[0];
+          star[k].se_lum = tempbinary.bse_lum[0];
+          star[k].se_mc = tempbinary.bse_massc[0];
+          star[k].se_rc = tempbinary.bse_radc[0];
+          star[k].se_menv = tempbinary.bse_menv[0];
+          star[k].se_renv = tempbinary.bse_renv[0];
+          star[k].se_ospin = tempbinary.bse_ospin[0];
+          star[k].se_B_0 = tempbinary.bse_B_0[0];
+          star[k].se_bacc = tempbinary.bse_bacc[0];
+          star[k].se_tacc = tempbinary.bse_tacc[0];
+          star[k].se_epoch = tempbinary.bse_epoch[0];
+          star[k].se_tms = tempbinary.bse_tms[0];
+          star[k].se_bhspin = tempbinary.bse_bhspin[0];
+        }
+
+        /* schedule the next full BSE call for remnants that can be skipped until then */
+        if (SE_SKIP_REMNANTS && se_is_quiescent(star[k].se_k)) {
+          star[k].se_tnext = star[k].se_tphys + SE_SKIP_INTERVAL;
+        }
 
         star[k].rad = star[k].se_radius * RSUN / units.l;
         star_m[g_k] = star[k].se_mt * MSUN / units.mstar;
         DMse -= star_m[g_k] * madhoc;
 
-        /* extract info from scm array */ /* PK looping over a large number anticipating further changes */
-	        i = 1;
-	        j = 1;
-        	while (bse_get_bcm(i,1)>=0.0 && i < 50000) {
-          		if(i > 1) {
-            			if(bse_get_bcm(i,2) == 13 && bse_get_bcm(i-1,2) < 13){
-              				if(bse_get_bcm(i+1,1) >= 0.0){
-                				star[k].se_scm_formation = bse_get_bcm(i+1,35);
-                //printf("stel, pulsar sin. 1 : %g %g %g %g %ld \n",star[k].se_B_0,star[k].se_ospin,bse_get_bcm(i+1,33),star[k].se_scm_formation,star[k].id);
-              				} else {
-                				star[k].se_scm_formation = bse_get_bcm(i,35);
-                //printf("stel, pulsar sin. 2 : %g %g %g %g %ld \n",star[k].se_B_0,star[k].se_ospin,bse_get_scm(i,33),star[k].se_scm_formation,star[k].id);
-              				}
-            			}
-          		}
-          		i++;
-        	}
-        	i--;
-        	if(i+1 > 50000){
-          		i = 0;
-        	}
-        	if(i>=1) {
-          		if(i>1){
-            			star[k].se_scm_B = bse_get_bcm(i,33);
-            			if(star[k].se_k == 13) {
-              //printf("stel, pulsar sin. 3 : %g %g %g \n",star[k].se_B_0,star[k].se_ospin,star[k].se_scm_B);
-            			}
-          		} else {
-            			star[k].se_scm_B = bse_get_bcm(i,33);
-            			if(star[k].se_k == 13) {
-              //printf("stel, pulsar sin. 4 : %g %g %g \n",star[k].se_B_0,star[k].se_ospin,star[k].se_scm_B);
-            			}
-          		}
-        	} else {
-          /*         bse_evolv1(&(star[k].se_k), &(star[k].se_mass), &(star[k].se_mt), &(star[k].se_radius), 
-                     &(star[k].se_lum), &(star[k].se_mc), &(star[k].se_rc), &(star[k].se_menv), 
-                     &(star[k].se_renv), &(star[k].se_ospin), 
-                     &(star[k].se_B_0), &(star[k].se_bacc), &(star[k].se_tacc), 
-                     &(star[k].se_epoch), &(star[k].se_tms), 
-                     &(star[k].se_tphys), &tphysf, &dtp, &METALLICITY, zpars, vs); */
-          		eprintf("Couldn't extract iso star bse info (looking for pulsar data)...");
-          		eprintf("Evolv1 info from non scm extraction: k=%ld, kw=%d mass=%g mt=%g rad=%g lum=%g tphysf=%g dtp=%g ",k,star[k].se_k,star[k].se_mass,star[k].se_mt,star[k].se_radius,star[k].se_lum,tphysf,dtp);
-          //           exit_cleanly(-1); //should only enter here if no bcm array entry, 
-          //                               and that should only happen to uninteresting systems and/or outcomes.
-        	}
+        /* info extracted from the bcm array by bse_evolv2_ctx() */
+        if (se_ctx.bcm_formation_found) {
+          star[k].se_scm_formation = se_ctx.bcm_formation;
+        }
+        if (se_ctx.nbcm >= 1) {
+          star[k].se_scm_B = se_ctx.bcm_B;
+        } else {
+          eprintf("Couldn't extract iso star bse info (looking for pulsar data)...");
+          eprintf("Evolv1 info from non scm extraction: k=%ld, kw=%d mass=%g mt=%g rad=%g lum=%g tphysf=%g dtp=%g ",k,star[k].se_k,star[k].se_mass,star[k].se_mt,star[k].se_radius,star[k].se_lum,tphysf,dtp);
+        }
 
         /* birth kicks */
         if (sqrt(vs[1]*vs[1]+vs[2]*vs[2]+vs[3]*vs[3]) != 0.0) {
@@ -606,38 +784,32 @@ void do_stellar_evolution(gsl_rng *rng)
 		/*If we've got a large MS star, we need to reduce the timestep, otherwise
 		 * we miss the transition from MS to HG to giant, and won't start applying
 		 * winds for massive stars at the right time*/
-		if(((binary[kb].bse_kw[0] <= 1 || binary[kb].bse_kw[0] == 7) & (binary[kb].bse_zams_mass[0] > BSE_PTS1_HIGHMASS_CUTOFF)) || ((binary[kb].bse_kw[1] <= 1 || binary[kb].bse_kw[1] == 7) & (binary[kb].bse_zams_mass[1] > BSE_PTS1_HIGHMASS_CUTOFF))){
-		    bse_set_pts1(BSE_PTS1/10.);
-		    reduced_timestep = 1;
-		}
+		se_ctx.pts1 = MIN(se_pts1(binary[kb].bse_kw[0], binary[kb].bse_zams_mass[0], binary[kb].bse_tphys, binary[kb].bse_epoch[0], binary[kb].bse_tms[0], tphysf),
+				se_pts1(binary[kb].bse_kw[1], binary[kb].bse_zams_mass[1], binary[kb].bse_tphys, binary[kb].bse_epoch[1], binary[kb].bse_tms[1], tphysf));
 
         /* set binary orbital period (in days) from a */
         binary[kb].bse_tb = sqrt(cub(binary[kb].a * units.l / AU)/(binary[kb].bse_mass[0]+binary[kb].bse_mass[1]))*365.25;
         DMse += (binary[kb].m1 + binary[kb].m2) * madhoc;
         /* Update star id for pass through. */
-        bse_set_id1_pass(binary[kb].id1);
-        bse_set_id2_pass(binary[kb].id2);
+        se_ctx.id1_pass = binary[kb].id1;
+        se_ctx.id2_pass = binary[kb].id2;
 		/* If this is a binary black hole, skip BSE and explicitly integrate the
 		 * Peters equations*/
 		if(binary[kb].bse_kw[0] == 14 && binary[kb].bse_kw[1] == 14){
 			integrate_a_e_peters_eqn(kb);
 			for (ii = 0 ; ii < 16 ; ii++) vs[ii] = 0.;
 		} else{
-			bse_set_taus113state(*curr_st, 0);
-			bse_evolv2_safely(&(binary[kb].bse_kw[0]), &(binary[kb].bse_mass0[0]), &(binary[kb].bse_mass[0]), &(binary[kb].bse_radius[0]), 
+			se_ctx.rng = *curr_st;
+			bse_evolv2_ctx(&se_ctx, &(binary[kb].bse_kw[0]), &(binary[kb].bse_mass0[0]), &(binary[kb].bse_mass[0]), &(binary[kb].bse_radius[0]), 
 				&(binary[kb].bse_lum[0]), &(binary[kb].bse_massc[0]), &(binary[kb].bse_radc[0]), &(binary[kb].bse_menv[0]), 
 					&(binary[kb].bse_renv[0]), &(binary[kb].bse_ospin[0]),
 						&(binary[kb].bse_B_0[0]), &(binary[kb].bse_bacc[0]), &(binary[kb].bse_tacc[0]),
 				&(binary[kb].bse_epoch[0]), &(binary[kb].bse_tms[0]), 
 				&(binary[kb].bse_tphys), &tphysf, &dtp, &METALLICITY, zpars, 
 				&(binary[kb].bse_tb), &(binary[kb].e), vs, &(binary[kb].bse_bhspin[0]));
-			*curr_st=bse_get_taus113state();
+			*curr_st = se_ctx.rng;
 		}
 
-		/*Reset the MS timestep once we're done*/
-		if(reduced_timestep == 1)
-		    bse_set_pts1(BSE_PTS1);
-
         if(isnan(binary[kb].bse_radius[0])){
               printf("id1=%ld id2=%ld\n",binary[kb].id1,binary[kb].id2);
           fprintf(stderr, "An isnan occured for r1 cmc_stellar_evolution.c\n");
@@ -689,6 +861,10 @@ void do_stellar_evolution(gsl_rng *rng)
     bh_count(k);
   }
 
+  if (SE_BATCH_SIZE > 0) {
+    bse_batch_free(&se_batch);
+  }
+
   double tmpTimeStart = timeStartSimple();
   double temp = 0.0;
 
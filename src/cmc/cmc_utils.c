@@ -11,7 +11,6 @@
 #include <sys/times.h>
 #include <sys/time.h>
 #include <gsl/gsl_errno.h>
-#include <gsl/gsl_spline.h>
 #include "cmc.h"
 #include "cmc_vars.h"
 #include "hdf5.h"
@@ -230,6 +229,9 @@ void free_arrays(void){
 
 	/* MPI Stuff */
 	free(star_r); free(star_m); free(star_phi);
+
+	if (SE_TABLE)
+		se_table_free();
 //Probably not needed anymore
 //	free(new_size); free(disp); free(len);
 }
@@ -598,13 +600,38 @@ int CheckCheckpoint() {
 
 
 
+/**
+* @brief contributions of local star i to the kinetic, potential (two terms), internal and binding energies summed up in ComputeEnergy()
+*
+* @param i local index of star
+* @param phi0 potential at the center
+* @param t array of 5 terms
+*/
+static void energy_terms(long i, double phi0, double *t)
+{
+	long j = get_global_idx(i);
+
+	t[0] = 0.5 * (sqr(star[i].vr) + sqr(star[i].vt)) * star_m[j]*madhoc;
+	t[1] = star_phi[j] * star_m[j]*madhoc;
+	t[2] = phi0 * cenma.m*madhoc / clus.N_MAX;
+	t[3] = 0.0;
+	t[4] = 0.0;
+	if (star[i].binind == 0) {
+		t[3] = star[i].Eint;
+	} else if (binary[star[i].binind].inuse) {
+		t[4] = -(binary[star[i].binind].m1*madhoc) * (binary[star[i].binind].m2*madhoc) / 
+			(2.0 * binary[star[i].binind].a);
+		t[3] = binary[star[i].binind].Eint1 + binary[star[i].binind].Eint2;
+	}
+}
+
 /**
 * @brief Calculates E,J for every star. Also, calculates, global energy variabies (parallel version of ComputeEnergy)
 */
 void ComputeEnergy(void)
 {
 	//MPI: buffer for reduce
-	double buf_reduce[5], phi0 = 0.0;
+	double buf_reduce[5], phi0 = 0.0, t[5];
 	int i, j=0;
 	for(i=0; i<5; i++)
 		buf_reduce[i] = 0.0;
@@ -617,29 +644,54 @@ void ComputeEnergy(void)
 
 	phi0 = star_phi[0];
 
-	//MPI: Calculating these variables on each processor
-	for (i=1; i<=mpiEnd-mpiBegin+1; i++) {
-		j = get_global_idx(i);
-		buf_reduce[1] += 0.5 * (sqr(star[i].vr) + sqr(star[i].vt)) * star_m[j]*madhoc;
-		buf_reduce[2] += star_phi[j] * star_m[j]*madhoc;
-		buf_reduce[2] += phi0 * cenma.m*madhoc / clus.N_MAX;
-
-		if (star[i].binind == 0) {
-			buf_reduce[3] += star[i].Eint;
-		} else if (binary[star[i].binind].inuse) {
-			buf_reduce[4] += -(binary[star[i].binind].m1*madhoc) * (binary[star[i].binind].m2*madhoc) / 
-				(2.0 * binary[star[i].binind].a);
-			buf_reduce[3] += binary[star[i].binind].Eint1 + binary[star[i].binind].Eint2;
+	if (REPRODUCIBLE_SUMS) {
+		/* the two potential terms go into the same sum */
+		double maxabs[4] = {0.0, 0.0, 0.0, 0.0}, M[4], step, part[4*REPRO_LEVELS], sums[4];
+
+		for (i=1; i<=mpiEnd-mpiBegin+1; i++) {
+			energy_terms(i, phi0, t);
+			maxabs[0] = MAX(maxabs[0], fabs(t[0]));
+			maxabs[1] = MAX(maxabs[1], MAX(fabs(t[1]), fabs(t[2])));
+			maxabs[2] = MAX(maxabs[2], fabs(t[3]));
+			maxabs[3] = MAX(maxabs[3], fabs(t[4]));
 		}
-	}
-	
-	buf_reduce[2] *= 0.5;
-	buf_reduce[0] = buf_reduce[1] + buf_reduce[2] + buf_reduce[3] + buf_reduce[4];
+		mpiReproBounds(maxabs, 4, 2*clus.N_MAX, M, &step, MPI_COMM_WORLD);
+
+		memset(part, 0, sizeof(part));
+		for (i=1; i<=mpiEnd-mpiBegin+1; i++) {
+			energy_terms(i, phi0, t);
+			reproAdd(t[0], M[0], step, &part[0]);
+			reproAdd(t[1], M[1], step, &part[REPRO_LEVELS]);
+			reproAdd(t[2], M[1], step, &part[REPRO_LEVELS]);
+			reproAdd(t[3], M[2], step, &part[2*REPRO_LEVELS]);
+			reproAdd(t[4], M[3], step, &part[3*REPRO_LEVELS]);
+		}
+		mpiReproFinish(part, 4, sums, MPI_COMM_WORLD);
 
-	//MPI: And now, summing them up across all processors. There might be slight round-off errors, but since these values are used only for diagnostics, we dont have to worry too much about it.
-	double tmpTimeStart = timeStartSimple();
-	MPI_Allreduce(MPI_IN_PLACE, buf_reduce, 5, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);		
-	timeEndSimple(tmpTimeStart, &t_comm);
+		buf_reduce[1] = sums[0];
+		buf_reduce[2] = 0.5 * sums[1];
+		buf_reduce[3] = sums[2];
+		buf_reduce[4] = sums[3];
+		buf_reduce[0] = buf_reduce[1] + buf_reduce[2] + buf_reduce[3] + buf_reduce[4];
+	} else {
+		//MPI: Calculating these variables on each processor
+		for (i=1; i<=mpiEnd-mpiBegin+1; i++) {
+			energy_terms(i, phi0, t);
+			buf_reduce[1] += t[0];
+			buf_reduce[2] += t[1];
+			buf_reduce[2] += t[2];
+			buf_reduce[3] += t[3];
+			buf_reduce[4] += t[4];
+		}
+
+		buf_reduce[2] *= 0.5;
+		buf_reduce[0] = buf_reduce[1] + buf_reduce[2] + buf_reduce[3] + buf_reduce[4];
+
+		//MPI: And now, summing them up across all processors. There might be slight round-off errors, but since these values are used only for diagnostics, we dont have to worry too much about it.
+		double tmpTimeStart = timeStartSimple();
+		MPI_Allreduce(MPI_IN_PLACE, buf_reduce, 5, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);		
+		timeEndSimple(tmpTimeStart, &t_comm);
+	}
 
 	Etotal.tot = buf_reduce[0];
 	Etotal.K = buf_reduce[1];
@@ -656,6 +708,37 @@ void ComputeEnergy(void)
 }
 
 
+/* the star_r/star_m gather of post_sort_comm_start(), split into segments of consecutive processes and
+   completed segment by segment in potential_calculate() */
+static struct {
+	int nseg;		/* number of segments; 0 if no gather is pending */
+	MPI_Request *req;	/* star_r and star_m request of each segment, outermost segment first */
+	long *lo;		/* lowest global index of each segment */
+	double mstars;		/* total mass of the stars inside SF_INFINITY */
+	long nstars;		/* number of stars inside SF_INFINITY */
+} pot_pipe;
+
+/**
+* @brief recomputes the potential at the stars from index k down to kmin, given the potential at k+1 and the mass inside r[k]
+*
+* @param kmin lowest index to compute
+* @param k index to start from; on return, kmin-1 (or unchanged if below kmin)
+* @param mprev mass inside star_r[k], updated as the sweep goes inward
+*/
+static void potential_sweep(long kmin, long *k, double *mprev)
+{
+	for (; *k >= kmin; (*k)--) {/* Recompute potential at each r */
+		star_phi[*k] = star_phi[*k + 1] - *mprev * (1.0 / star_r[*k] - 1.0 / star_r[*k + 1]);
+		*mprev -= star_m[*k] / clus.N_STAR;
+		if (isnan(star_phi[*k])) {
+		  eprintf("NaN in phi[%li] detected\n", *k);
+		  eprintf("phi[k+1]=%g mprev=%g, r[k]=%g, r[k+1]=%g, m[k]=%g, clus.N_STAR=%li\n", 
+		  	star_phi[*k + 1], *mprev, star_r[*k], star_r[*k + 1], star_m[*k], clus.N_STAR);
+		  exit_cleanly(-1,__FUNCTION__);
+		}
+	}
+}
+
 /**
 * @brief Parallel version of potential_calculate(). Currently the entire calculation is done by all nodes since it uses only the duplicated arrays r and m, but might consider parallelization in the long term to improve scalability.
    Computing the potential at each star sorted by increasing
@@ -675,25 +758,36 @@ void ComputeEnergy(void)
 long potential_calculate(void) {
 	long k;
 	double mprev;
+	int s, sentinel;
 
-	/* count up all the mass and set N_MAX */
-	k = 1;
-	mprev = 0.0;
-	
-	//No idea why N_STAR_NEW was used instead of N_MAX. Changing this to N_MAX.
-	//while (star_r[k] < SF_INFINITY && k <= clus.N_STAR_NEW) {
-	while (star_r[k] < SF_INFINITY && k <= clus.N_MAX) {
-		mprev += star_m[k];
-		/* I guess NaNs do happen... */
+	if (pot_pipe.nseg > 0) {
+		/* star_r and star_m are still arriving; their totals were gathered in post_sort_comm_start() */
+		clus.N_MAX = pot_pipe.nstars;
+		mprev = pot_pipe.mstars;
 		if(isnan(mprev)){
 			eprintf("NaN (2) detected\n");
 			exit_cleanly(-1, __FUNCTION__);
 		}
-		k++;
-	}
+	} else {
+		/* count up all the mass and set N_MAX */
+		k = 1;
+		mprev = 0.0;
+
+		//No idea why N_STAR_NEW was used instead of N_MAX. Changing this to N_MAX.
+		//while (star_r[k] < SF_INFINITY && k <= clus.N_STAR_NEW) {
+		while (star_r[k] < SF_INFINITY && k <= clus.N_MAX) {
+			mprev += star_m[k];
+			/* I guess NaNs do happen... */
+			if(isnan(mprev)){
+				eprintf("NaN (2) detected\n");
+				exit_cleanly(-1, __FUNCTION__);
+			}
+			k++;
+		}
 
-	/* New N_MAX */
-	clus.N_MAX = k - 1;
+		/* New N_MAX */
+		clus.N_MAX = k - 1;
+	}
 
 	/* update central BH mass */
 	cenma.m += cenma.m_new;
@@ -710,21 +804,32 @@ long potential_calculate(void) {
 	/* zero boundary star first for safety */
 	//zero_star(clus.N_MAX + 1);
 
-	star_r[clus.N_MAX + 1] = SF_INFINITY;
 	star_phi[clus.N_MAX + 1] = 0.0;
 
 	//MPI: In future consider parallelization. For now, done by all processors.
 	mprev = Mtotal;
-	for (k = clus.N_MAX; k >= 1; k--) {/* Recompute potential at each r */
-		star_phi[k] = star_phi[k + 1] - mprev * (1.0 / star_r[k] - 1.0 / star_r[k + 1]);
-		mprev -= star_m[k] / clus.N_STAR;
-		if (isnan(star_phi[k])) {
-		  eprintf("NaN in phi[%li] detected\n", k);
-		  eprintf("phi[k+1]=%g mprev=%g, r[k]=%g, r[k+1]=%g, m[k]=%g, clus.N_STAR=%li\n", 
-		  	star_phi[k + 1], mprev, star_r[k], star_r[k + 1], star_m[k], clus.N_STAR);
-		  exit_cleanly(-1,__FUNCTION__);
+	k = clus.N_MAX;
+	if (pot_pipe.nseg > 0) {
+		/* sweep each segment as soon as it has arrived, outermost first; the sentinel is only written
+		   once no pending receive covers it */
+		sentinel = 0;
+		for (s=0; s<pot_pipe.nseg; s++) {
+			double tmpTimeStart = timeStartSimple();
+			MPI_Waitall(2, &pot_pipe.req[2*s], MPI_STATUSES_IGNORE);
+			timeEndSimple(tmpTimeStart, &t_comm);
+
+			if (!sentinel && pot_pipe.lo[s] <= clus.N_MAX + 1) {
+				star_r[clus.N_MAX + 1] = SF_INFINITY;
+				sentinel = 1;
+			}
+			if (sentinel)
+				potential_sweep(pot_pipe.lo[s], &k, &mprev);
 		}
+		pot_pipe.nseg = 0;
+	} else {
+		star_r[clus.N_MAX + 1] = SF_INFINITY;
 	}
+	potential_sweep(1, &k, &mprev);
 
 	star_phi[0] = star_phi[1]+ cenma.m*madhoc/star_r[1]; /* U(r=0) is U_1 */
 	if (isnan(star_phi[0])) {
@@ -763,6 +868,154 @@ int find_stars_mass_bin(double smass){
 	return bn;
 }
 
+/**
+* @brief sets up a streaming weighted quantile: n samples with total weight wtot are passed to wquantile_add() in order of increasing position, and the position where the cumulative weight reaches the fraction q[i] of wtot is stored in out[i]. Positions are linearly interpolated in the cumulative fraction between samples, starting from position 0 at fraction 0. No samples are stored.
+*
+* @param wq quantile state
+* @param nq number of fractions
+* @param q fractions, in increasing order
+* @param out array of nq quantiles to be filled
+* @param wtot total weight of the samples
+* @param n number of samples
+*/
+void wquantile_init(wquantile_t *wq, int nq, double *q, double *out, double wtot, long n)
+{
+	wq->nq = nq;
+	wq->q = q;
+	wq->out = out;
+	wq->wtot = wtot;
+	wq->wcum = 0.0;
+	wq->pprev = 0.0;
+	wq->xprev = 0.0;
+	wq->n = n;
+	wq->next = 0;
+}
+
+/**
+* @brief adds the next sample to a streaming weighted quantile
+*
+* @param wq quantile state
+* @param x position of sample (not smaller than that of the previous sample)
+* @param w weight of sample
+*/
+void wquantile_add(wquantile_t *wq, double x, double w)
+{
+	double p;
+
+	wq->wcum += w;
+	p = wq->wcum / wq->wtot;
+	while (wq->next < wq->nq && wq->q[wq->next] < p) {
+		wq->out[wq->next] = wq->xprev + (wq->q[wq->next] - wq->pprev)/(p - wq->pprev) * (x - wq->xprev);
+		wq->next++;
+	}
+	wq->pprev = p;
+	wq->xprev = x;
+}
+
+/**
+* @brief finishes a streaming weighted quantile after the last sample: fractions that weren't crossed (100%, or beyond through round-off) are set to the position of the last sample. With a single sample all quantiles are its position, and with no samples out is left untouched.
+*
+* @param wq quantile state
+*/
+void wquantile_finish(wquantile_t *wq)
+{
+	if (wq->n == 0)
+		return;
+	if (wq->n == 1)
+		wq->next = 0;
+	for (; wq->next < wq->nq; wq->next++)
+		wq->out[wq->next] = wq->xprev;
+}
+
+/* per-timestep scratch arena: temporary N-sized arrays are carved out of it with scratch_alloc() and all
+   released at once by scratch_reset() at the end of the timestep. The arena is a chain of blocks, so
+   earlier allocations stay valid when it grows; on reset the chain is replaced by a single block large
+   enough for the whole of the last timestep. */
+typedef struct scratch_block {
+	struct scratch_block *next;
+	size_t size, used;
+} scratch_block_t;
+
+static scratch_block_t *scratch_head = NULL;
+static size_t scratch_hint = 0;
+#define SCRATCH_ALIGN 16
+#define SCRATCH_ROUND(size) (((size) + SCRATCH_ALIGN - 1) / SCRATCH_ALIGN * SCRATCH_ALIGN)
+
+/**
+* @brief borrows memory from the scratch arena. It is valid until the next call of scratch_reset(), and must not be freed.
+*
+* @param size number of bytes
+*
+* @return pointer to the memory
+*/
+void *scratch_alloc(size_t size)
+{
+	scratch_block_t *b;
+	size_t bsize;
+	char *p;
+
+	size = SCRATCH_ROUND(size);
+	if (scratch_head == NULL || scratch_head->used + size > scratch_head->size) {
+		bsize = MAX(size, scratch_hint);
+		if (scratch_head != NULL)
+			bsize = MAX(bsize, 2 * scratch_head->size);
+		b = (scratch_block_t *) malloc(SCRATCH_ROUND(sizeof(scratch_block_t)) + bsize);
+		if (b == NULL) {
+			eprintf("cannot allocate %zu bytes of scratch space\n", bsize);
+			exit_cleanly(-1, __FUNCTION__);
+		}
+		b->next = scratch_head;
+		b->size = bsize;
+		b->used = 0;
+		scratch_head = b;
+	}
+
+	p = (char *) scratch_head + SCRATCH_ROUND(sizeof(scratch_block_t)) + scratch_head->used;
+	scratch_head->used += size;
+	return(p);
+}
+
+/**
+* @brief borrows zeroed memory from the scratch arena, see scratch_alloc()
+*
+* @param n number of elements
+* @param size size of one element
+*
+* @return pointer to the memory
+*/
+void *scratch_calloc(size_t n, size_t size)
+{
+	void *p = scratch_alloc(n * size);
+
+	memset(p, 0, n * size);
+	return(p);
+}
+
+/**
+* @brief releases everything borrowed from the scratch arena. Called once at the end of each timestep.
+*/
+void scratch_reset(void)
+{
+	scratch_block_t *b, *next;
+
+	if (scratch_head == NULL)
+		return;
+
+	if (scratch_head->next == NULL) {
+		scratch_head->used = 0;
+		return;
+	}
+
+	/* the timestep needed more than one block: the next block allocated covers all of them */
+	scratch_hint = 0;
+	for (b=scratch_head; b!=NULL; b=next) {
+		next = b->next;
+		scratch_hint += b->size;
+		free(b);
+	}
+	scratch_head = NULL;
+}
+
 /**
 * @brief computes the Lagrange radii for various mass bins stored in the array mass_bins[NO_MASS_BINS]
 */
@@ -772,100 +1025,92 @@ void comp_multi_mass_percent(){
 	/* mass bins are stored in the array mass_bins[NO_MASS_BINS] */
 	double *mtotal_inbin; // total mass in each mass bin
 	long *number_inbin;   // # of stars in each mass bin
-	double *mcount_inbin, *r_inbin;
-	long *ncount_inbin;
-	int *star_bins;       // array holding which bin each star is in
-	double **rs, **percents;
+	wquantile_t *wq;
 	long i;
-
-	/* GSL interpolation function and accelerators. See:
-	 * http://sources.redhat.com/gsl/ref/gsl-ref_26.html#SEC391*/
-	gsl_interp_accel **acc;
-	gsl_spline **spline;
+	int sbin;
 
 	if (NO_MASS_BINS <=1) return;
 
+	/* first pass: the totals of each bin are needed to turn mass into fractions */
 	mtotal_inbin = (double *) calloc(NO_MASS_BINS, sizeof(double));
 	number_inbin = (long *) calloc(NO_MASS_BINS, sizeof(long));
-	r_inbin = (double *) calloc(NO_MASS_BINS, sizeof(double));
-	star_bins = (int *) malloc((clus.N_MAX+2)*sizeof(int));
 	for (i = 1; i <= clus.N_MAX; i++) {
-		star_bins[i] = find_stars_mass_bin(star_m[i]/SOLAR_MASS_DYN);
-		if (star_bins[i] == -1) continue; /* -1: star isn't in legal bin */
-		mtotal_inbin[star_bins[i]] += star_m[i];
-		number_inbin[star_bins[i]]++;
-		r_inbin[star_bins[i]] = star_r[i];
-	}
-	/* populate arrays rs[NO_MASS_BINS][j] and percents[][] */
-	rs = (double **) malloc(NO_MASS_BINS*sizeof(double *));
-	percents = (double **) malloc(NO_MASS_BINS*sizeof(double *));
-	for(i=0; i<NO_MASS_BINS; i++){
-		/* +1 below is to accomodate rs=0 <-> percents=0 point */
-		rs[i] = (double *) malloc((number_inbin[i]+1)*sizeof(double));
-		percents[i] = (double *) malloc((number_inbin[i]+1)*sizeof(double));
-	}
-	for(i=0; i<NO_MASS_BINS; i++){
-		/* at r=0 there is 0% of mass */
-		rs[i][0] = percents[i][0] = 0.0;
+		sbin = find_stars_mass_bin(star_m[i]/SOLAR_MASS_DYN);
+		if (sbin == -1) continue; /* -1: star isn't in legal bin */
+		mtotal_inbin[sbin] += star_m[i];
+		number_inbin[sbin]++;
 	}
-	
-	mcount_inbin = (double *) calloc(NO_MASS_BINS, sizeof(double));
-	ncount_inbin = (long *) calloc(NO_MASS_BINS, sizeof(long));
+
+	/* second pass: stream the stars of each bin through its quantile engine */
+	wq = (wquantile_t *) malloc(NO_MASS_BINS*sizeof(wquantile_t));
+	for (i = 0; i < NO_MASS_BINS; i++)
+		wquantile_init(&wq[i], MASS_PC_COUNT, mass_pc, multi_mass_r[i], mtotal_inbin[i], number_inbin[i]);
 	for (i = 1; i <= clus.N_MAX; i++) {
-		int sbin = star_bins[i];
+		sbin = find_stars_mass_bin(star_m[i]/SOLAR_MASS_DYN);
 		if (sbin == -1) continue;
-		mcount_inbin[sbin] += star_m[i];
-		ncount_inbin[sbin]++;
-		rs[sbin][ncount_inbin[sbin]] = star_r[i];
-		percents[sbin][ncount_inbin[sbin]] = 
-				mcount_inbin[sbin]/mtotal_inbin[sbin];
+		wquantile_add(&wq[sbin], star_r[i], star_m[i]);
 	}
-	free(mcount_inbin); free(ncount_inbin);
-	
-	acc = (gsl_interp_accel **) malloc(NO_MASS_BINS*sizeof(gsl_interp_accel));
-	spline = (gsl_spline **) malloc(NO_MASS_BINS*sizeof(gsl_spline));
-	for(i=0; i<NO_MASS_BINS; i++){
-		if((number_inbin[i] == 1) || (number_inbin[i] == 0)) continue;
-		acc[i] = gsl_interp_accel_alloc();
-		/* change gsl_interp_linear to gsl_interp_cspline below,
-		 * for spline interpolation; however, this may result in
-		 * negative LR values for small mass percentages! */ 
-		/* +1's below are to accomodate rs=0 <-> percents=0 point */
-		spline[i] = gsl_spline_alloc(gsl_interp_linear, number_inbin[i]+1);
-		gsl_spline_init (spline[i], percents[i], rs[i], number_inbin[i]+1);
-	}
-	for(i=0; i<NO_MASS_BINS; i++){
-		free(rs[i]); free(percents[i]);
-	}
-	free(rs); free(percents);
-	
-	/* fill multi_mass_r[][] by calling gsl_spline_eval() */
-	for (i = 0; i <NO_MASS_BINS; i++) {
-		int mcnt;
-		if (number_inbin[i] == 0) {
-			continue;
-		} else if (number_inbin[i] == 1) {
-			for(mcnt=0; mcnt<MASS_PC_COUNT; mcnt++){
-				multi_mass_r[i][mcnt] = r_inbin[i];
-			}
-		} else {
-			for(mcnt=0; mcnt<MASS_PC_COUNT; mcnt++){
-				multi_mass_r[i][mcnt] = 
-					gsl_spline_eval(spline[i], mass_pc[mcnt], acc[i]);
-			}
-		}
+	for (i = 0; i < NO_MASS_BINS; i++)
+		wquantile_finish(&wq[i]);
+
+	free(wq);
+	free(mtotal_inbin); free(number_inbin);
+}
+		
+/**
+* @brief reproducible version of the sums of the kinetic energies and v^2 within the Lagrange radii in comp_mass_percent(). Each local star is added to the segment between two consecutive Lagrange radii it falls in, the exact pre-rounded partial sums are accumulated over the segments, and a single reduction gives the sums within every radius.
+*
+* @param lag_k global indices of the stars at the Lagrange radii
+* @param mstart first Lagrange radius to compute the sums for
+* @param mend one past the last Lagrange radius to compute the sums for
+*/
+static void comp_mass_percent_sums_repro(long *lag_k, int mstart, int mend)
+{
+	long i, g_i, nseg = mend - mstart;
+	int s, c;
+	double t[4], maxabs[4] = {0.0, 0.0, 0.0, 0.0}, M[4], step, *part, *sums;
+
+	if (nseg <= 0) return;
+
+	for (i=1; i<=clus.N_MAX_NEW; i++) {
+		g_i = get_global_idx(i);
+		maxabs[0] = MAX(maxabs[0], 0.5 * star_m[g_i] * madhoc * star[i].vr * star[i].vr);
+		maxabs[1] = MAX(maxabs[1], 0.5 * star_m[g_i] * madhoc * star[i].vt * star[i].vt);
+		maxabs[2] = MAX(maxabs[2], star[i].vr * star[i].vr);
+		maxabs[3] = MAX(maxabs[3], star[i].vt * star[i].vt);
+	}
+	mpiReproBounds(maxabs, 4, clus.N_MAX, M, &step, MPI_COMM_WORLD);
+
+	part = (double *) calloc(nseg*4*REPRO_LEVELS, sizeof(double));
+	sums = (double *) malloc(nseg*4*sizeof(double));
+	s = 0;
+	for (i=1; i<=clus.N_MAX_NEW; i++) {
+		g_i = get_global_idx(i);
+		while (s < nseg && lag_k[mstart+s] < g_i)
+			s++;
+		if (s == nseg) break;
+		t[0] = 0.5 * star_m[g_i] * madhoc * star[i].vr * star[i].vr;
+		t[1] = 0.5 * star_m[g_i] * madhoc * star[i].vt * star[i].vt;
+		t[2] = star[i].vr * star[i].vr;
+		t[3] = star[i].vt * star[i].vt;
+		for (c=0; c<4; c++)
+			reproAdd(t[c], M[c], step, &part[(4*s+c)*REPRO_LEVELS]);
 	}
-	for(i=0; i<NO_MASS_BINS; i++){
-		if((number_inbin[i] == 1) || (number_inbin[i] == 0)) continue;
-		gsl_interp_accel_free(acc[i]); 
-		gsl_spline_free(spline[i]);
+	/* the partial sums are exact, so accumulating them over the segments is too */
+	for (i=4*REPRO_LEVELS; i<nseg*4*REPRO_LEVELS; i++)
+		part[i] += part[i-4*REPRO_LEVELS];
+	mpiReproFinish(part, nseg*4, sums, MPI_COMM_WORLD);
+
+	for (s=0; s<nseg; s++) {
+		ke_rad_r[mstart+s] = sums[4*s];
+		ke_tan_r[mstart+s] = sums[4*s+1];
+		v2_rad_r[mstart+s] = sums[4*s+2];
+		v2_tan_r[mstart+s] = sums[4*s+3];
 	}
-	free(acc); free(spline);
-	
-	free(mtotal_inbin); free(number_inbin); free(r_inbin); 
-	free(star_bins);
+	free(part);
+	free(sums);
 }
-		
+
 /**
 * @brief Computes radii containing mass_pc[] % of the mass
 */
@@ -895,12 +1140,34 @@ void comp_mass_percent(){
 		mcount=0;
 	}
 
+	if (REPRODUCIBLE_SUMS) {
+		/* find the Lagrange radii first, then do all the sums within them in one go */
+		long *lag_k = (long *) malloc(MASS_PC_COUNT * sizeof(long));
+		int mstart = mcount;
+
+		for (k = 1; k <= clus.N_MAX && mcount < MASS_PC_COUNT; k++) {
+			mprev += star_m[k] / clus.N_STAR;
+
+			if (mprev > mass_pc[mcount] * Mtotal) {
+				mass_r[mcount] = star_r[k];
+				ave_mass_r[mcount] = mprev/Mtotal/k*initial_total_mass;
+				no_star_r[mcount] = k;
+				densities_r[mcount] = mprev / (4.0 / 3.0 * PI * pow(star_r[k],3));
+				lag_k[mcount] = k;
+				mcount++;
+			}
+		}
+		comp_mass_percent_sums_repro(lag_k, mstart, mcount);
+		free(lag_k);
+		return;
+	}
+
 	/* MPI: The parallelization of this part is not entirely trivial */
 	/* MPI: Instead of cumulating a single value for these variables, we store all intermediate values in an array */
-    double *ke_rad_prev_arr = (double*) calloc(clus.N_MAX_NEW+1, sizeof(double));
-    double *ke_tan_prev_arr = (double*) calloc(clus.N_MAX_NEW+1, sizeof(double));
-    double *v2_rad_prev_arr = (double*) calloc(clus.N_MAX_NEW+1, sizeof(double));
-    double *v2_tan_prev_arr = (double*) calloc(clus.N_MAX_NEW+1, sizeof(double));
+    double *ke_rad_prev_arr = (double*) scratch_calloc(clus.N_MAX_NEW+1, sizeof(double));
+    double *ke_tan_prev_arr = (double*) scratch_calloc(clus.N_MAX_NEW+1, sizeof(double));
+    double *v2_rad_prev_arr = (double*) scratch_calloc(clus.N_MAX_NEW+1, sizeof(double));
+    double *v2_tan_prev_arr = (double*) scratch_calloc(clus.N_MAX_NEW+1, sizeof(double));
 
 	 for (k = 1; k <= clus.N_MAX_NEW; k++) {
 		 int g_k = get_global_idx(k);
@@ -974,11 +1241,6 @@ void comp_mass_percent(){
 		}
 	}
 	timeEndSimple(tmpTimeStart, &t_comm);
-
-    free(ke_rad_prev_arr);
-    free(ke_tan_prev_arr);
-    free(v2_rad_prev_arr);
-    free(v2_tan_prev_arr);
 }
 
 /* The potential computed using the star[].phi computed at the star locations in star[].r sorted by increasing r.*/
@@ -1152,6 +1414,39 @@ void update_vars(void)
 			}
 		}
 	}
+	if (REPRODUCIBLE_SUMS) {
+		/* N_b is exact anyway; M_b and E_b are summed again with pre-rounding */
+		double maxabs[2] = {0.0, 0.0}, M[2], step, part[2*REPRO_LEVELS], sums[2];
+
+		for (i=1; i<=mpiEnd-mpiBegin+1; i++) {
+			k = star[i].binind;
+			if (k != 0) {
+				maxabs[0] = MAX(maxabs[0], star_m[get_global_idx(i)]);
+				if (binary[k].inuse)
+					maxabs[1] = MAX(maxabs[1], fabs((binary[k].m1/clus.N_STAR) * (binary[k].m2/clus.N_STAR) / (2.0 * binary[k].a)));
+			}
+		}
+		mpiReproBounds(maxabs, 2, clus.N_MAX, M, &step, MPI_COMM_WORLD);
+
+		memset(part, 0, sizeof(part));
+		for (i=1; i<=mpiEnd-mpiBegin+1; i++) {
+			k = star[i].binind;
+			if (k != 0) {
+				reproAdd(star_m[get_global_idx(i)], M[0], step, &part[0]);
+				if (binary[k].inuse)
+					reproAdd((binary[k].m1/clus.N_STAR) * (binary[k].m2/clus.N_STAR) / (2.0 * binary[k].a), M[1], step, &part[REPRO_LEVELS]);
+			}
+		}
+		mpiReproFinish(part, 2, sums, MPI_COMM_WORLD);
+		M_b = sums[0];
+		E_b = sums[1];
+
+		double tmpTimeStart = timeStartSimple();
+		MPI_Allreduce(MPI_IN_PLACE, &N_b, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);		
+		timeEndSimple(tmpTimeStart, &t_comm);
+		return;
+	}
+
 	double tmpTimeStart = timeStartSimple();
 	MPI_Allreduce(MPI_IN_PLACE, &M_b, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);		
 	MPI_Allreduce(MPI_IN_PLACE, &E_b, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);		
@@ -1238,9 +1533,10 @@ double compute_tidal_boundary(void){
 */
 void central_calculate(void)
 {
-	double m=0.0, *rhoj, mrho, Vrj, rhojsum, Msincentral, Mbincentral, Vcentral, rcentral;
+	double m=0.0, *rhoj=NULL, mrho, Vrj, rhojsum, Msincentral, Mbincentral, Vcentral, rcentral;
 	long J=6, i, j, jmin, jmax, nave, Ncentral;
 	double rhoj2sum;
+	double tmpTimeStart;
 
 	//MPI: The first part is done on all nodes, since they mostly need only the duplicated arrays. The second part is done on the root node, and broadcasted to all other nodes. Parallelization is mostly trivial and easily understandable from reading the code.
 	/* average over all stars out to half-mass radius */
@@ -1256,69 +1552,113 @@ void central_calculate(void)
 		exit_cleanly(-1, __FUNCTION__);
 	}
 
-	/* allocate array for local density calculations */
-	rhoj = (double *) malloc((nave+1) * sizeof(double));
-
-	/* calculate rhoj's as in Eq. II.2 of Casertano & Hut (1985) */
-	for (i=1; i<=nave; i++) {
-		jmin = MAX(i-J/2, 1);
-		jmax = jmin + J;
-		mrho = 0.0;
-		/* this is equivalent to their J-1 factor for the case of equal masses,
-		   and seems like a good generalization for unequal masses */
-		for (j=jmin+1; j<=jmax-1; j++) {
-			mrho += star_m[j] * madhoc;
+	if (CENTRAL_DISTRIBUTED) {
+		/* each node only does its own stars, with the slice-plus-halo estimator of density_estimators();
+		   every star out to nave+J is a member, so the windows are the same as below */
+		long ilo = MAX(1, mpiBegin), ihi = MIN(nave, mpiEnd), nloc = MAX(ihi-ilo+1, 0);
+		long nmem = MAX(MIN(nave+J, mpiEnd)-ilo+1, 0), *idx = (long *) scratch_alloc(MAX(nmem, 1) * sizeof(long));
+		double rho, *terms = (double *) malloc(MAX(nloc, 1) * 6 * sizeof(double)), sums[6];
+
+		for (i=0; i<nmem; i++)
+			idx[i] = ilo + i;
+		rhoj = density_slice(idx, nloc, nmem, J);
+
+		for (i=ilo; i<=ihi; i++) {
+			rho = rhoj[i-ilo];
+			terms[6*(i-ilo)] = rho;
+			terms[6*(i-ilo)+1] = sqr(rho);
+			terms[6*(i-ilo)+2] = rho * star_r[i];
+			terms[6*(i-ilo)+3] = sqr(rho * star_r[i]);
+			terms[6*(i-ilo)+4] = rho * star_m[i] * madhoc;
+			terms[6*(i-ilo)+5] = rho * (sqr(star[get_local_idx(i)].vr) + sqr(star[get_local_idx(i)].vt));
 		}
-		Vrj = 4.0/3.0 * PI * (fb_cub(star_r[jmax]) - fb_cub(star_r[jmin]));
-		rhoj[i] = mrho / Vrj;
-	}
 
-	/* calculate core quantities using mass-density-weighted averages; note that in 
-	   Casertano & Hut (1985) only rho and rc are analyzed and tested */
-	rhojsum = 0.0;
-	rhoj2sum = 0.0;
-	central.rho = 0.0;   /* density-weighted density from Eq. II.5 of Casertano & Hut (1985), with estimator bias correction (see below) */
-	central.v_rms = 0.0; /* root-mean-squared density-weighted velocity */
-	central.rc = 0.0;    /* density-weighted core radius from Eq. II.4 of Casertano & Hut (1985) */
-	rc_nb = 0.0;         /* (density squared)-weighted core radius used in NBODY6, originating from Eq. 5 of McMillan, Hut & Makino (1990) */
-	central.m_ave = 0.0; /* density-weighted average central mass */
-	for (i=1; i<=nave; i++) {
-		rhojsum += rhoj[i];
-		rhoj2sum += sqr(rhoj[i]);
-		central.rho += sqr(rhoj[i]);
-		if( i >= mpiBegin && i <= mpiEnd )
-			central.v_rms += rhoj[i] * (sqr(star[get_local_idx(i)].vr) + sqr(star[get_local_idx(i)].vt));
-
-		central.rc += rhoj[i] * star_r[i];
-		rc_nb += sqr(rhoj[i] * star_r[i]);
-		central.m_ave += rhoj[i] * star_m[i] * madhoc;
-	}
+		mpiReproSum(terms, nloc, 6, nave, sums, MPI_COMM_WORLD);
+		free(terms);
 
+		rhojsum = sums[0];
+		rhoj2sum = sums[1];
+		central.rho = sums[1];
+		central.rc = sums[2];
+		rc_nb = sums[3];
+		central.m_ave = sums[4];
+		central.v_rms = sums[5];
+	} else {
+		/* allocate array for local density calculations */
+		rhoj = (double *) scratch_alloc((nave+1) * sizeof(double));
+
+		/* calculate rhoj's as in Eq. II.2 of Casertano & Hut (1985) */
+		for (i=1; i<=nave; i++) {
+			jmin = MAX(i-J/2, 1);
+			jmax = jmin + J;
+			mrho = 0.0;
+			/* this is equivalent to their J-1 factor for the case of equal masses,
+			   and seems like a good generalization for unequal masses */
+			for (j=jmin+1; j<=jmax-1; j++) {
+				mrho += star_m[j] * madhoc;
+			}
+			Vrj = 4.0/3.0 * PI * (fb_cub(star_r[jmax]) - fb_cub(star_r[jmin]));
+			rhoj[i] = mrho / Vrj;
+		}
 
-//MPI: This reduce gives round-off errors which affect the timestep mildly. So summing up in order.
-/*
-	double tmpTimeStart = timeStartSimple();
-		MPI_Allreduce(MPI_IN_PLACE, &central.v_rms, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-	timeEndSimple(tmpTimeStart, &t_comm);
-*/
-    //MPI: Avoiding reduce to improve accuracy, and comparison with serial version.
-    double tmpTimeStart = timeStartSimple();
-    double temp = 0.0;
-    double v_rms = central.v_rms;
+		/* calculate core quantities using mass-density-weighted averages; note that in 
+		   Casertano & Hut (1985) only rho and rc are analyzed and tested */
+		rhojsum = 0.0;
+		rhoj2sum = 0.0;
+		central.rho = 0.0;   /* density-weighted density from Eq. II.5 of Casertano & Hut (1985), with estimator bias correction (see below) */
+		central.v_rms = 0.0; /* root-mean-squared density-weighted velocity */
+		central.rc = 0.0;    /* density-weighted core radius from Eq. II.4 of Casertano & Hut (1985) */
+		rc_nb = 0.0;         /* (density squared)-weighted core radius used in NBODY6, originating from Eq. 5 of McMillan, Hut & Makino (1990) */
+		central.m_ave = 0.0; /* density-weighted average central mass */
+		for (i=1; i<=nave; i++) {
+			rhojsum += rhoj[i];
+			rhoj2sum += sqr(rhoj[i]);
+			central.rho += sqr(rhoj[i]);
+			if( i >= mpiBegin && i <= mpiEnd && !REPRODUCIBLE_SUMS )
+				central.v_rms += rhoj[i] * (sqr(star[get_local_idx(i)].vr) + sqr(star[get_local_idx(i)].vt));
+
+			central.rc += rhoj[i] * star_r[i];
+			rc_nb += sqr(rhoj[i] * star_r[i]);
+			central.m_ave += rhoj[i] * star_m[i] * madhoc;
+		}
 
-    MPI_Status stat;
 
-    if(myid!=0)
-    MPI_Send(&central.v_rms, 1, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);
-    else
-        for(i=1;i<procs;i++)
-        {
-            MPI_Recv(&temp, 1, MPI_DOUBLE, i, 0, MPI_COMM_WORLD, &stat);
-            v_rms += temp;
-        }
-    central.v_rms = v_rms;
-    MPI_Bcast(&central.v_rms, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-    timeEndSimple(tmpTimeStart, &t_comm);
+		//MPI: This reduce gives round-off errors which affect the timestep mildly. So summing up in order.
+		/*
+			double tmpTimeStart = timeStartSimple();
+				MPI_Allreduce(MPI_IN_PLACE, &central.v_rms, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+			timeEndSimple(tmpTimeStart, &t_comm);
+		*/
+		if (REPRODUCIBLE_SUMS) {
+			/* only v_rms needs local data; sum it up independently of the number of processors */
+			long ilo = MAX(1, mpiBegin), ihi = MIN(nave, mpiEnd), nloc = MAX(ihi-ilo+1, 0);
+			double *terms = (double *) malloc(MAX(nloc, 1) * sizeof(double));
+
+			for (i=ilo; i<=ihi; i++)
+				terms[i-ilo] = rhoj[i] * (sqr(star[get_local_idx(i)].vr) + sqr(star[get_local_idx(i)].vt));
+			mpiReproSum(terms, nloc, 1, nave, &central.v_rms, MPI_COMM_WORLD);
+			free(terms);
+		} else {
+			//MPI: Avoiding reduce to improve accuracy, and comparison with serial version.
+			tmpTimeStart = timeStartSimple();
+			double temp = 0.0;
+			double v_rms = central.v_rms;
+
+			MPI_Status stat;
+
+			if(myid!=0)
+			MPI_Send(&central.v_rms, 1, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);
+			else
+				for(i=1;i<procs;i++)
+				{
+					MPI_Recv(&temp, 1, MPI_DOUBLE, i, 0, MPI_COMM_WORLD, &stat);
+					v_rms += temp;
+				}
+			central.v_rms = v_rms;
+			MPI_Bcast(&central.v_rms, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+			timeEndSimple(tmpTimeStart, &t_comm);
+		}
+	}
 
 	central.rho /= rhojsum;
 	central.rho *= 4.0/5.0; /* correction for inherent bias in estimator, from Eqs. III.3 and V.2 of Casertano & Hut (1985)  */
@@ -1479,8 +1819,6 @@ void central_calculate(void)
 	/* set global variables that are used throughout the code */
 	rho_core_single = central.rho_sin;
 	rho_core_bin = central.rho_bin;
-	
-	free(rhoj);
 }
 
 /**
@@ -2144,6 +2482,9 @@ void calc_timestep(gsl_rng *rng)
 		Dt = Prev_Dt * 1.1;
 	}
 
+	if (BLOCK_TIMESTEP_LEVELS > 1)
+		block_timestep_calculate(Dt);
+
 	TotalTime += Dt;
 }
 
@@ -2249,6 +2590,10 @@ void qsorts_new(void)
                 				SAMPLESIZE );
 	clus.N_MAX_NEW = temp;
 
+	/* the binaries were repacked into slots 1 to N_b_local */
+	arrays_shrink_to_fit();
+	binary_slots_reset(N_b_local);
+
 	MPI_Type_free(&startype);
 	MPI_Type_free(&binarytype);
 }
@@ -2261,9 +2606,10 @@ void post_sort_comm()
 	double tmpTimeStart = timeStartSimple();
 	int i;
 	mpiFindDispAndLenCustom( clus.N_MAX, MIN_CHUNK_SIZE, mpiDisp, mpiLen );
+	global_arrays_reserve(clus.N_MAX + 2);
 
-	double *temp_r = (double *) malloc( ((int)clus.N_MAX_NEW+1) * sizeof(double) );
-	double *temp_m = (double *) malloc( ((int)clus.N_MAX_NEW+1) * sizeof(double) );
+	double *temp_r = (double *) scratch_alloc( ((int)clus.N_MAX_NEW+1) * sizeof(double) );
+	double *temp_m = (double *) scratch_alloc( ((int)clus.N_MAX_NEW+1) * sizeof(double) );
 	
 	//MPI:OPT: Can be made more efficient by using MPI datatypes.
 	for(i=1; i<=clus.N_MAX_NEW; i++) {
@@ -2276,14 +2622,75 @@ void post_sort_comm()
     //MPI: No idea why this is not working. Consult Wei-keng.
     //MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, star_r, mpiLen, mpiDisp, MPI_DOUBLE, MPI_COMM_WORLD);
     //MPI_Allgatherv(MPI_IN_PLACE, mpiLen[myid], MPI_DOUBLE, star_m, mpiLen, mpiDisp, MPI_DOUBLE, MPI_COMM_WORLD);
-    MPI_Allgatherv(temp_r+1, mpiLen[myid], MPI_DOUBLE, star_r, mpiLen, mpiDisp, MPI_DOUBLE, MPI_COMM_WORLD);
-    MPI_Allgatherv(temp_m+1, mpiLen[myid], MPI_DOUBLE, star_m, mpiLen, mpiDisp, MPI_DOUBLE, MPI_COMM_WORLD);
+    node_allgatherv(temp_r+1, mpiLen[myid], star_r, mpiLen, mpiDisp, MPI_DOUBLE);
+    node_allgatherv(temp_m+1, mpiLen[myid], star_m, mpiLen, mpiDisp, MPI_DOUBLE);
+
+	MPI_Allreduce(MPI_IN_PLACE, &cenma.m_new, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);		
+	MPI_Allreduce(MPI_IN_PLACE, &cenma.E_new, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);		
+
+	timeEndSimple(tmpTimeStart, &t_comm);
+}
+
+/**
+* @brief Pipelined version of post_sort_comm() for POTENTIAL_PIPELINE_SEGMENTS. The gather of star_r and star_m is started as one nonblocking Iallgatherv per segment of consecutive processes, outermost first, and only completed in potential_calculate(), which sweeps each segment as soon as it has arrived. The number of stars inside SF_INFINITY and their total mass are gathered right away, so the sweep can start from the outside. The potential must be calculated before star_r or star_m are used.
+*/
+void post_sort_comm_start(void)
+{
+	double tmpTimeStart = timeStartSimple();
+	int i, s, first, last, nseg, mine, *cnt, *displs;
+	double part[2], *parts;
+
+	mpiFindDispAndLenCustom( clus.N_MAX, MIN_CHUNK_SIZE, mpiDisp, mpiLen );
+	global_arrays_reserve(clus.N_MAX + 2);
+
+	double *temp_r = (double *) scratch_alloc( ((int)clus.N_MAX_NEW+1) * sizeof(double) );
+	double *temp_m = (double *) scratch_alloc( ((int)clus.N_MAX_NEW+1) * sizeof(double) );
+
+	/* mass and number of this node's stars inside SF_INFINITY */
+	part[0] = part[1] = 0.0;
+	for(i=1; i<=clus.N_MAX_NEW; i++) {
+		temp_r[i] = star[i].r;
+		temp_m[i] = star[i].m;
+		if (star[i].r < SF_INFINITY) {
+			part[0] += star[i].m;
+			part[1] += 1.0;
+		}
+	}
+
+	/* the counts and displacements have to stay untouched until the gathers complete */
+	nseg = MIN(POTENTIAL_PIPELINE_SEGMENTS, procs);
+	pot_pipe.nseg = nseg;
+	pot_pipe.req = (MPI_Request *) scratch_alloc(2 * nseg * sizeof(MPI_Request));
+	pot_pipe.lo = (long *) scratch_alloc(nseg * sizeof(long));
+	cnt = (int *) scratch_alloc(nseg * procs * sizeof(int));
+	displs = (int *) scratch_alloc(procs * sizeof(int));
+	memcpy(displs, mpiDisp, procs * sizeof(int));
+
+	for (s=0; s<nseg; s++) {
+		/* segment s holds the pieces of the processes first..last-1, counted from the outermost group */
+		first = (nseg-1-s) * procs / nseg;
+		last = (nseg-s) * procs / nseg;
+		for (i=0; i<procs; i++)
+			cnt[s*procs+i] = (i >= first && i < last) ? mpiLen[i] : 0;
+		pot_pipe.lo[s] = displs[first];
+		mine = cnt[s*procs+myid];
+		MPI_Iallgatherv(temp_r+1, mine, MPI_DOUBLE, star_r, cnt+s*procs, displs, MPI_DOUBLE, MPI_COMM_WORLD, &pot_pipe.req[2*s]);
+		MPI_Iallgatherv(temp_m+1, mine, MPI_DOUBLE, star_m, cnt+s*procs, displs, MPI_DOUBLE, MPI_COMM_WORLD, &pot_pipe.req[2*s+1]);
+	}
+
+	/* totals are summed in the order of the processes, so that every node gets the same Mtotal */
+	parts = (double *) scratch_alloc(2 * procs * sizeof(double));
+	MPI_Allgather(part, 2, MPI_DOUBLE, parts, 2, MPI_DOUBLE, MPI_COMM_WORLD);
+	pot_pipe.mstars = 0.0;
+	pot_pipe.nstars = 0;
+	for (i=0; i<procs; i++) {
+		pot_pipe.mstars += parts[2*i];
+		pot_pipe.nstars += (long) (parts[2*i+1] + 0.5);
+	}
 
 	MPI_Allreduce(MPI_IN_PLACE, &cenma.m_new, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);		
 	MPI_Allreduce(MPI_IN_PLACE, &cenma.E_new, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);		
 
-	free(temp_r);
-	free(temp_m);
 	timeEndSimple(tmpTimeStart, &t_comm);
 }
 